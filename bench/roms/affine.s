@@ -0,0 +1,102 @@
+@ Modes 1 and 2: affine backgrounds, updated per scanline through H-blank DMA.
+.include "common.inc"
+main:
+  ldr r0, =0x05000000
+  mov r2, #0
+1:
+  mov r1, r2, lsl #5
+  add r1, r1, r2, lsr #2
+  bic r1, r1, #0x8000
+  strh r1, [r0], #2
+  add r2, r2, #1
+  cmp r2, #256
+  bne 1b
+  @ 8bpp tiles charblock 0
+  ldr r0, =0x06000000
+  ldr r3, =0x1234
+  ldr r2, =0x2000
+1:
+  add r3, r3, r3, lsl #2
+  add r3, r3, #7
+  strh r3, [r0], #2
+  subs r2, r2, #1
+  bne 1b
+  @ affine maps (bytes) screenblock 16.. (0x8000), 16KB
+  ldr r0, =0x06008000
+  mov r2, #0
+1:
+  mov r1, r2
+  and r1, r1, #0xFF
+  add r1, r1, r2, lsr #8
+  strh r1, [r0], #2
+  add r2, r2, #1
+  cmp r2, #0x2000
+  bne 1b
+  @ per-line table for HBlank DMA in EWRAM: 160 halfwords
+  ldr r0, =0x02000000
+  mov r2, #0
+1:
+  mov r1, r2, lsl #1
+  add r1, r1, #0x80
+  strh r1, [r0], #2
+  add r2, r2, #1
+  cmp r2, #228
+  bne 1b
+  ST16 0x0400000C, 0xE081   @ BG2: sb16, wrap, size 3, prio 1
+  ST16 0x0400000E, 0x6484   @ BG3: sb 20, wrap, size1, cb1
+  ST16 0x04000008, 0x1800
+  ST16 0x04000000, 0x0D02   @ mode 2 BG2, BG3, BG0 (ignored)
+  mov r8, #0
+loop:
+  WAITLINE 160
+  add r8, r8, #1
+  ldr r0, =0x04000020
+  and r1, r8, #0x7F
+  add r1, r1, #0xC0
+  strh r1, [r0]          @ PA
+  and r1, r8, #0x3F
+  strh r1, [r0, #2]      @ PB
+  rsb r1, r1, #0
+  strh r1, [r0, #4]      @ PC
+  ldr r1, =0x100
+  strh r1, [r0, #6]      @ PD
+  mov r1, r8, lsl #8
+  str r1, [r0, #8]       @ BG2X
+  str r1, [r0, #0xC]     @ BG2Y
+  ldr r0, =0x04000030
+  ldr r1, =0x80
+  strh r1, [r0]
+  strh r1, [r0, #6]
+  mov r1, r8, lsl #9
+  str r1, [r0, #8]
+  @ mode switch every 128 frames between 1 and 2
+  tst r8, #128
+  ldr r0, =0x04000000
+  ldreq r1, =0x0D02
+  ldrne r1, =0x0701
+  strh r1, [r0]
+  @ HBlank DMA0: EWRAM table -> BG2PA each line, repeat
+  ldr r0, =0x040000B0
+  ldr r1, =0x02000000
+  str r1, [r0]
+  ldr r1, =0x04000020
+  str r1, [r0, #4]
+  ldr r1, =0xA2400001   @ enable, hblank, repeat, dst fixed(2<<5=0x40), count 1
+  str r1, [r0, #8]
+  @ mosaic toggle
+  ldr r0, =0x0400004C
+  and r1, r8, #0xFF
+  strh r1, [r0]
+  WAITLINE 40
+  ldr r0, =0x0400000C
+  ldr r1, =0xE0C1        @ enable mosaic on BG2 mid-frame
+  strh r1, [r0]
+  WAITLINE 120
+  ldr r0, =0x0400000C
+  ldr r1, =0xE081
+  strh r1, [r0]
+  ldr r0, =0x04000028
+  mov r1, r8, lsl #10
+  str r1, [r0]           @ reload BG2X mid frame
+  b loop
+.ltorg
@@ -0,0 +1,79 @@
+@ Audio: all four PSG channels and both FIFOs fed by DMA, with timer-driven sample rates.
+.include "common.inc"
+main:
+  ST16 0x04000084, 0x0080   @ master on
+  ST16 0x04000080, 0xFF77   @ psg all channels both sides, vol max
+  ST16 0x04000082, 0x0B0E   @ dma A: full vol, L+R, timer0; B: timer1 R
+  ST16 0x04000082, 0xBB0E   @ reset fifos
+  ST16 0x04000088, 0x0200
+  @ PSG1 sweep + duty
+  ST16 0x04000060, 0x0027
+  ST16 0x04000062, 0xF780
+  ST16 0x04000064, 0x8500
+  @ PSG2
+  ST16 0x04000068, 0xA340
+  ST16 0x0400006C, 0x8620
+  @ PSG3 wave
+  ST32 0x04000090, 0x01234567
+  ST32 0x04000094, 0x89ABCDEF
+  ST32 0x04000098, 0xFEDCBA98
+  ST32 0x0400009C, 0x76543210
+  ST16 0x04000070, 0x0080
+  ST16 0x04000072, 0x2000
+  ST16 0x04000074, 0x8400
+  @ PSG4 noise
+  ST16 0x04000078, 0xF300
+  ST16 0x0400007C, 0x8052
+  @ DMA1 -> FIFO A from ROM, DMA2 -> FIFO B
+  ST32 0x040000BC, 0x08000000
+  ST32 0x040000C0, 0x040000A0
+  ST32 0x040000C4, 0xB6000000
+  ST32 0x040000C8, 0x08000100
+  ST32 0x040000CC, 0x040000A4
+  ST32 0x040000D0, 0xB6000000
+  @ timer0 ~ 16khz, timer1 ~ 13khz, timer2 overflow every cycle, timer3 cascade
+  ST16 0x04000100, 0xFBFF
+  ST16 0x04000102, 0x0080
+  ST16 0x04000104, 0xFAFF
+  ST16 0x04000106, 0x0080
+  ST16 0x04000108, 0xFFFF
+  ST16 0x0400010A, 0x0080
+  ST16 0x0400010C, 0xFF00
+  ST16 0x0400010E, 0x0084
+  mov r8, #0
+loop:
+  WAITLINE 100
+  add r8, r8, #1
+  @ retrigger psg channels with changing frequency
+  tst r8, #15
+  bne 2f
+  ldr r0, =0x04000064
+  and r1, r8, #0x3F0
+  orr r1, r1, #0x8000
+  orr r1, r1, #0x300
+  strh r1, [r0]
+  ldr r0, =0x0400006C
+  and r1, r8, #0x1F0
+  orr r1, r1, #0x8500
+  strh r1, [r0]
+  ldr r0, =0x0400007C
+  and r1, r8, #0x70
+  orr r1, r1, #0x8000
+  orr r1, r1, #0x03
+  strh r1, [r0]
+2:
+  @ change bias resolution periodically
+  ldr r0, =0x04000088
+  mov r1, r8, lsr #6
+  and r1, r1, #3
+  mov r1, r1, lsl #14
+  orr r1, r1, #0x200
+  strh r1, [r0]
+  @ change timer0 reload occasionally
+  ldr r0, =0x04000100
+  and r1, r8, #0xF0
+  ldr r2, =0xFA00
+  orr r1, r1, r2
+  strh r1, [r0]
+  b loop
+.ltorg
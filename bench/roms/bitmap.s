@@ -0,0 +1,151 @@
+@ Modes 3, 4 and 5: bitmap backgrounds with page flipping and a few sprites.
+.include "common.inc"
+main:
+  ldr r0, =0x05000000
+  mov r2, #0
+1:
+  mov r1, r2, lsl #6
+  eor r1, r1, r2
+  bic r1, r1, #0x8000
+  strh r1, [r0], #2
+  add r2, r2, #1
+  cmp r2, #512
+  bne 1b
+  @ obj tiles in bitmap-accessible area 0x06014000
+  ldr r0, =0x06014000
+  ldr r2, =0x2000
+  ldr r3, =0x5555
+1:
+  add r3, r3, r3, lsl #1
+  strh r3, [r0], #2
+  subs r2, r2, #1
+  bne 1b
+  @ few sprites with tile 512+
+  ldr r0, =0x07000000
+  mov r2, #0
+1:
+  mov r1, r2, lsl #4
+  and r1, r1, #0x7F
+  orr r1, r1, #0x4000
+  strh r1, [r0], #2
+  mov r1, r2, lsl #5
+  orr r1, r1, #0x4000
+  strh r1, [r0], #2
+  ldr r1, =0x200
+  add r1, r1, r2, lsl #3
+  strh r1, [r0], #2
+  add r0, r0, #2
+  add r2, r2, #1
+  cmp r2, #16
+  bne 1b
+  @ remaining sprites disabled
+  ldr r1, =0x0200
+1:
+  strh r1, [r0], #8
+  add r2, r2, #1
+  cmp r2, #128
+  bne 1b
+  mov r8, #0
+loop:
+  WAITLINE 160
+  add r8, r8, #1
+  @ select scene by (frame >> 5) % 8
+  mov r9, r8, lsr #5
+  and r9, r9, #7
+  @ default affine identity
+  ldr r0, =0x04000020
+  ldr r1, =0x100
+  strh r1, [r0]
+  mov r1, #0
+  strh r1, [r0, #2]
+  strh r1, [r0, #4]
+  ldr r1, =0x100
+  strh r1, [r0, #6]
+  mov r1, #0
+  str r1, [r0, #8]
+  str r1, [r0, #0xC]
+  ldr r0, =0x04000050
+  mov r1, #0
+  strh r1, [r0]
+  ldr r0, =0x04000000
+  cmp r9, #0
+  ldreq r1, =0x0403      @ mode3 BG2 only
+  cmp r9, #1
+  ldreq r1, =0x0404      @ mode4 BG2 only
+  cmp r9, #2
+  ldreq r1, =0x0414      @ mode4 frame 1
+  cmp r9, #3
+  ldreq r1, =0x0405      @ mode5
+  cmp r9, #4
+  ldreq r1, =0x1443      @ mode3 + OBJ 1D
+  cmp r9, #5
+  ldreq r1, =0x0403      @ mode3 with scroll
+  cmp r9, #6
+  ldreq r1, =0x0404      @ mode4 with blending
+  cmp r9, #7
+  ldreq r1, =0x0483      @ forced blank
+  strh r1, [r0]
+  cmp r9, #5
+  bne 2f
+  ldr r0, =0x04000028
+  mov r1, r8, lsl #8
+  str r1, [r0]
+  ldr r0, =0x04000020
+  ldr r1, =0xF0
+  strh r1, [r0]
+2:
+  cmp r9, #6
+  bne 2f
+  ldr r0, =0x04000050
+  ldr r1, =0x00C4
+  strh r1, [r0]
+  ldr r0, =0x04000054
+  mov r1, #6
+  strh r1, [r0]
+2:
+  @ DMA3 fill vram rows with a frame dependent word (32-bit fill) 
+  ldr r0, =0x03000000
+  mov r1, r8, lsl #5
+  orr r1, r1, r8, lsl #21
+  eor r1, r1, #0x00FF0000
+  str r1, [r0]
+  ldr r0, =0x040000D4
+  ldr r1, =0x03000000
+  str r1, [r0]
+  ldr r1, =0x06000000
+  and r2, r8, #31
+  add r1, r1, r2, lsl #11
+  str r1, [r0, #4]
+  ldr r1, =0x85000200    @ enable, 32bit, src fixed, 512 words
+  str r1, [r0, #8]
+  @ CPU gradient writes to a few lines
+  ldr r0, =0x06000000
+  and r2, r8, #63
+  mov r3, #480
+  mla r0, r2, r3, r0
+  mov r2, #0
+1:
+  add r1, r2, r8
+  strh r1, [r0], #2
+  add r2, r2, #1
+  cmp r2, #240
+  bne 1b
+  @ mode 4 byte-ish writes: write halfwords into page 1
+  ldr r0, =0x0600A000
+  and r2, r8, #127
+  mov r3, #240
+  mla r0, r2, r3, r0
+  mov r2, #0
+1:
+  add r1, r2, r8, lsl #8
+  strh r1, [r0], #2
+  add r2, r2, #1
+  cmp r2, #120
+  bne 1b
+  @ palette change
+  ldr r0, =0x05000000
+  and r2, r8, #0xFF
+  add r0, r0, r2, lsl #1
+  strh r8, [r0]
+  b loop
+.ltorg
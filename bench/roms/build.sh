@@ -0,0 +1,10 @@
+#!/bin/sh
+# Assembles the benchmark ROMs, requires llvm-mc and llvm-objcopy.
+set -e
+cd "$(dirname "$0")"
+for source in *.s; do
+  name=${source%.s}
+  llvm-mc -triple=armv4t-none-eabi -filetype=obj $source -o $name.o
+  llvm-objcopy -O binary --only-section=.text $name.o $name.gba
+  rm $name.o
+done
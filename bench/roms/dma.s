@@ -0,0 +1,84 @@
+@ DMA: large immediate transfers between all memory areas every frame, plus H-blank DMA.
+.include "common.inc"
+.macro DMA3 src, dst, ctl
+  ldr r0, =0x040000D4
+  ldr r1, =\src
+  str r1, [r0]
+  ldr r1, =\dst
+  str r1, [r0, #4]
+  ldr r1, =\ctl
+  str r1, [r0, #8]
+.endm
+@ store timer 2 counter to VRAM pixel (r7 = pixel pointer, advances)
+.macro STAMP
+  ldr r0, =0x04000108
+  ldrh r1, [r0]
+  strh r1, [r7], #2
+.endm
+main:
+  @ fill EWRAM with an LCG
+  ldr r0, =0x02000000
+  ldr r2, =0x10000
+  ldr r3, =0x12345678
+  ldr r4, =1103515245
+  ldr r5, =12345
+1:
+  mla r6, r3, r4, r5
+  mov r3, r6
+  str r3, [r0], #4
+  subs r2, r2, #1
+  bne 1b
+  ST16 0x04000000, 0x0403
+  @ timers: t0 fast reload, t1 cascade, t2 free running
+  ST16 0x04000100, 0xFFF0
+  ST16 0x04000102, 0x0080
+  ST16 0x04000106, 0x0084
+  ST16 0x0400010A, 0x0080
+  @ waitstates: prefetch on, WS0 3/1
+  ST16 0x04000204, 0x4014
+  @ HBlank DMA1 (repeat, reload dst) EWRAM -> VRAM mid screen
+  ST32 0x040000C8, 0x02001000
+  ST32 0x040000CC, 0x06009600
+  ST32 0x040000D0, 0xA6600010
+  mov r8, #0
+loop:
+  WAITLINE 150
+  ldr r7, =0x06000000
+  STAMP
+  @ large upload, 32-bit increment
+  DMA3 0x02000000, 0x06000040, 0x84004B00
+  STAMP
+  @ decrement both, 16-bit
+  DMA3 0x02030000, 0x03004800, 0x80A00400
+  STAMP
+  @ fixed source fill
+  DMA3 0x02000100, 0x06010000, 0x85000100
+  STAMP
+  @ overlapping forward copy inside VRAM (smear)
+  DMA3 0x06000100, 0x06000110, 0x80000800
+  STAMP
+  @ IWRAM to VRAM, src increment, dst decrement
+  DMA3 0x03004000, 0x06005000, 0x84200200
+  STAMP
+  @ ROM (with prefetch) to EWRAM, then to PRAM/OAM
+  DMA3 0x08000000, 0x02020000, 0x84000100
+  STAMP
+  DMA3 0x02020000, 0x05000000, 0x84000100
+  STAMP
+  DMA3 0x02020000, 0x07000000, 0x84000100
+  STAMP
+  @ fixed destination
+  DMA3 0x02001000, 0x03006000, 0x84400080
+  STAMP
+  @ ROM beyond end of file
+  DMA3 0x08010000, 0x06006000, 0x84000100
+  STAMP
+  @ IWRAM -> VRAM copy mirrored range
+  DMA3 0x03004000, 0x06018000, 0x84000400
+  STAMP
+  @ make the IWRAM results visible
+  DMA3 0x03004000, 0x06008000, 0x84000800
+  STAMP
+  add r8, r8, #1
+  b loop
+.ltorg
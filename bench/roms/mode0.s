@@ -0,0 +1,148 @@
+@ Mode 0: four text backgrounds with mosaic, blending and a window, 128 sprites and mid-frame raster effects.
+.include "common.inc"
+main:
+  @ palette: gradient
+  ldr r0, =0x05000000
+  mov r2, #0
+1:
+  mov r1, r2, lsl #7
+  eor r1, r1, r2, lsl #2
+  eor r1, r1, r2, lsr #3
+  bic r1, r1, #0x8000
+  strh r1, [r0], #2
+  add r2, r2, #1
+  cmp r2, #512
+  bne 1b
+  @ tiles: charblock 0 and 1 (32K), pseudo random pattern
+  ldr r0, =0x06000000
+  ldr r3, =0x12345678
+  ldr r2, =0x4000
+1:
+  add r3, r3, r3, lsl #5
+  eor r3, r3, r3, lsr #7
+  add r3, r3, #0x3F
+  strh r3, [r0], #2
+  subs r2, r2, #1
+  bne 1b
+  @ maps: screenblocks 24..31 (0xC000..0x10000)
+  ldr r0, =0x0600C000
+  mov r2, #0
+1:
+  mov r1, r2, lsr #1
+  and r1, r1, #0xFF
+  and r4, r2, #0x7
+  orr r1, r1, r4, lsl #12
+  tst r2, #0x20
+  orrne r1, r1, #0x400
+  tst r2, #0x100
+  orrne r1, r1, #0x800
+  strh r1, [r0], #2
+  add r2, r2, #1
+  cmp r2, #0x2000
+  bne 1b
+  @ obj tiles at 0x06010000
+  ldr r0, =0x06010000
+  ldr r3, =0x9876
+  ldr r2, =0x4000
+1:
+  add r3, r3, r3, lsl #3
+  eor r3, r3, r3, lsr #5
+  strh r3, [r0], #2
+  subs r2, r2, #1
+  bne 1b
+  @ OAM: 128 sprites
+  ldr r0, =0x07000000
+  mov r2, #0
+1:
+  mov r1, r2, lsl #3          @ y
+  and r1, r1, #0xFF
+  and r4, r2, #3
+  orr r1, r1, r4, lsl #14     @ shape
+  tst r2, #8
+  orrne r1, r1, #0x400        @ semi transparent
+  tst r2, #16
+  orrne r1, r1, #0x100        @ affine
+  tst r2, #32
+  orrne r1, r1, #0x2000       @ 256 colors
+  strh r1, [r0], #2
+  mov r1, r2, lsl #4
+  ldr r4, =0x1FF
+  and r1, r1, r4
+  and r4, r2, #0x3
+  orr r1, r1, r4, lsl #14     @ size
+  tst r2, #64
+  orrne r1, r1, #0x1000
+  strh r1, [r0], #2
+  mov r1, r2, lsl #2
+  and r4, r2, #3
+  orr r1, r1, r4, lsl #10     @ prio
+  strh r1, [r0], #2
+  ldr r1, =0x100
+  tst r2, #1
+  ldrne r1, =0xC0
+  strh r1, [r0], #2
+  add r2, r2, #1
+  cmp r2, #128
+  bne 1b
+  @ BG control
+  ST16 0x04000008, 0x1800   @ BG0: sb 24, cb0, prio 0
+  ST16 0x0400000A, 0x5981   @ BG1: sb 25, size 1, prio1
+  ST16 0x0400000C, 0x9AC6   @ BG2: sb 26, cb1, 8bpp, mosaic, size 2, prio 2
+  ST16 0x0400000E, 0xDC07   @ BG3: sb 28, cb1, size3, prio3
+  ST16 0x04000050, 0x2F41   @ BLDCNT: alpha, BG0 over everything
+  ST16 0x04000052, 0x0A06
+  ST16 0x04000040, 0x2080   @ WIN0H
+  ST16 0x04000044, 0x1070   @ WIN0V
+  ST16 0x04000048, 0x3F1B
+  ST16 0x0400004A, 0x1F26
+  ST16 0x0400004C, 0x3232   @ mosaic
+  ST16 0x04000000, 0x3F40   @ mode 0, all BG, OBJ, WIN0, 1D
+  mov r8, #0
+loop:
+  WAITLINE 160
+  add r8, r8, #1
+  ldr r0, =0x04000010
+  strh r8, [r0]
+  mov r1, r8, lsr #1
+  strh r1, [r0, #2]
+  rsb r1, r8, #0
+  strh r1, [r0, #4]
+  strh r8, [r0, #6]
+  strh r1, [r0, #8]
+  strh r8, [r0, #0xE]
+  @ move window
+  and r1, r8, #0x3F
+  add r1, r1, #0x10
+  orr r1, r1, r1, lsl #8
+  add r1, r1, #0x40
+  ldr r0, =0x04000040
+  strh r1, [r0]
+  @ move sprites
+  ldr r0, =0x07000002
+  mov r2, #0
+2:
+  ldrh r1, [r0]
+  add r1, r1, #1
+  strh r1, [r0], #8
+  add r2, r2, #1
+  cmp r2, #128
+  bne 2b
+  @ mid frame raster effects
+  WAITLINE 60
+  ldr r0, =0x04000012
+  strh r8, [r0]
+  ldr r0, =0x04000054
+  mov r1, #8
+  strh r1, [r0]
+  ldr r0, =0x04000050
+  ldr r1, =0x00C1
+  strh r1, [r0]
+  WAITLINE 100
+  ldr r0, =0x04000050
+  ldr r1, =0x2F41
+  strh r1, [r0]
+  @ palette tweak mid frame
+  ldr r0, =0x05000002
+  strh r8, [r0]
+  b loop
+.ltorg
@@ -25,6 +25,9 @@ public:
   Resampler(std::shared_ptr<WriteStream<T>> output) : output(output) {}
 
   virtual ~Resampler() {}
+
+  // Discards the input history, as if no samples had been written yet.
+  virtual void Reset() = 0;
   
   virtual void SetSampleRates(float samplerate_in, float samplerate_out) {
     resample_phase_shift = samplerate_in / samplerate_out;
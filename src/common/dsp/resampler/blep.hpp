@@ -44,6 +44,11 @@ public:
     }
   }
 
+  void Reset() final {
+    previous = {};
+    resample_phase = 0;
+  }
+
   void Write(T const& input) final {
     while (resample_phase < 1.0) {
       auto index = resample_phase * kLUTsize;
@@ -18,6 +18,13 @@ public:
     : Resampler<T>(output)
   { }
   
+  void Reset() final {
+    previous[0] = {};
+    previous[1] = {};
+    previous[2] = {};
+    resample_phase = 0;
+  }
+
   void Write(T const& input) final {
     while (resample_phase < 1.0) {
       // http://paulbourke.net/miscellaneous/interpolation/
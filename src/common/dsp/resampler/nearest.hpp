@@ -18,6 +18,10 @@ public:
     : Resampler<T>(output)
   { }
   
+  void Reset() final {
+    resample_phase = 0;
+  }
+
   void Write(T const& input) final {
     while (resample_phase < 1.0) {
       this->output->Write(input);
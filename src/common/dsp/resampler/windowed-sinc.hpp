@@ -7,89 +7,177 @@
 
 #pragma once
 
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
 #include "../resampler.hpp"
-#include "../ring_buffer.hpp"
 
 namespace common::dsp {
 
+/* Blackman-windowed sinc kernels only depend on the number of points and the cutoff frequency.
+ * Each kernel is computed once and then shared by all resamplers in the process.
+ */
+class SincKernelCache {
+public:
+  static constexpr int s_resolution = 512;
+
+  static auto Get(int points, float cutoff) -> std::shared_ptr<float const[]> {
+    static std::mutex mutex;
+    static std::map<std::pair<int, float>, std::shared_ptr<float const[]>> cache;
+
+    std::lock_guard<std::mutex> guard(mutex);
+
+    auto& kernel = cache[{ points, cutoff }];
+    if (!kernel) {
+      kernel = Compute(points, cutoff);
+    }
+    return kernel;
+  }
+
+private:
+  /* The kernel is stored per phase, so that all taps for one output sample are contiguous.
+   * There is one extra phase, because the phase is rounded to the nearest table entry.
+   */
+  static auto Compute(int points, float cutoff) -> std::shared_ptr<float const[]> {
+    auto lut = std::shared_ptr<float[]>{new float[(s_resolution + 1) * points]};
+    double kernelSum = 0.0;
+
+    for (int m = 0; m <= s_resolution; m++) {
+      for (int n = 0; n < points; n++) {
+        double t  = m/double(s_resolution);
+        double x1 = M_PI * (t - n + points/2) + 1e-6;
+        double x2 = 2 * M_PI * (n + t)/points; 
+        double sinc = std::sin(cutoff * x1)/x1;
+        double blackman = 0.42 - 0.49 * std::cos(x2) + 0.076 * std::cos(2 * x2);
+        
+        lut[m * points + n] = sinc * blackman;
+        if (m != s_resolution) {
+          kernelSum += sinc * blackman;
+        }
+      }
+    }
+    
+    kernelSum /= s_resolution;
+    
+    for (int i = 0; i < (s_resolution + 1) * points; i++) {
+      lut[i] /= kernelSum;
+    }
+
+    return lut;
+  }
+};
+
 template <typename T, int points>
 class SincResampler : public Resampler<T> {
 public:
   static_assert((points % 4) == 0, "DSP::SincResampler<T, points>: points must be divisible by four.");
+  static_assert(std::is_same_v<T, float> || std::is_same_v<T, StereoSample<float>>,
+    "DSP::SincResampler<T, points>: T must be float or StereoSample<float>.");
 
   SincResampler(std::shared_ptr<WriteStream<T>> output) 
     : Resampler<T>(output)
   {
+    history = std::make_unique<float[]>(s_channels * s_history_length);
+
     SetSampleRates(1, 1);
+    Reset();
+  }
 
-    for (int i = 0; i < points - 1; i++) {
-      taps.Write({});
+  void Reset() final {
+    // The history starts out with (points - 1) silent samples.
+    for (int i = 0; i < s_channels * s_history_length; i++) {
+      history[i] = 0;
     }
+    history_end = points - 1;
+    resample_phase = 0;
   }
   
   void SetSampleRates(float samplerate_in, float samplerate_out) final {
     Resampler<T>::SetSampleRates(samplerate_in, samplerate_out);
     
-    float kernelSum = 0.0;
     float cutoff = 1.0;//0.9;
     
     if (this->resample_phase_shift > 1.0) {
       cutoff /= this->resample_phase_shift;
     }
 
-    for (int n = 0; n < points; n++) {
-      for (int m = 0; m < s_lut_resolution; m++) {
-        double t  = m/double(s_lut_resolution);
-        double x1 = M_PI * (t - n + points/2) + 1e-6;
-        double x2 = 2 * M_PI * (n + t)/points; 
-        double sinc = std::sin(cutoff * x1)/x1;
-        double blackman = 0.42 - 0.49 * std::cos(x2) + 0.076 * std::cos(2 * x2);
-        
-        lut[n * s_lut_resolution+m] = sinc * blackman;
-        kernelSum += sinc * blackman;
-      }
-    }
-    
-    kernelSum /= s_lut_resolution;
-    
-    for (int i = 0; i < points * s_lut_resolution; i++) {
-      lut[i] /= kernelSum;
+    // The rate may be adjusted slightly and often, avoid the cache lookup if the kernel stays the same.
+    if (!lut || cutoff != lut_cutoff) {
+      lut = SincKernelCache::Get(points, cutoff);
+      lut_cutoff = cutoff;
     }
   }
 
   void Write(T const& input) final {
-    taps.Write(input);
-
-    while (resample_phase < 1.0) { 
-      T sample = {};
-
-      int x = int(std::round(resample_phase * s_lut_resolution));
-      
-      for (int n = 0; n < points; n += 4) {        
-        sample += taps.Peek(n + 0) * lut[x + 0 * s_lut_resolution];
-        sample += taps.Peek(n + 1) * lut[x + 1 * s_lut_resolution]; 
-        sample += taps.Peek(n + 2) * lut[x + 2 * s_lut_resolution]; 
-        sample += taps.Peek(n + 3) * lut[x + 3 * s_lut_resolution];
-        
-        x += 4 * s_lut_resolution;
+    // Move the most recent samples to the front, once the end of the history is reached.
+    if (history_end == s_history_length) {
+      for (int channel = 0; channel < s_channels; channel++) {
+        auto data = &history[channel * s_history_length];
+        std::memmove(data, data + s_history_length - (points - 1), (points - 1) * sizeof(float));
       }
+      history_end = points - 1;
+    }
 
-      this->output->Write(sample);
+    if constexpr (s_channels == 1) {
+      history[history_end] = input;
+    } else {
+      history[history_end] = input.left;
+      history[history_end + s_history_length] = input.right;
+    }
+
+    history_end++;
+
+    while (resample_phase < 1.0) {
+      int x = int(std::round(resample_phase * SincKernelCache::s_resolution));
+
+      this->output->Write(Convolve(&lut[x * points]));
 
       resample_phase += this->resample_phase_shift;
     }
 
-    taps.Read();
-
     resample_phase = resample_phase - 1.0;
   }
   
 private:
-  static constexpr int s_lut_resolution = 512;
+  static constexpr int s_history_length = points + 1024;
+  static constexpr int s_channels = std::is_same_v<T, float> ? 1 : 2;
+
+  /* Both channels are processed in the same pass over the kernel.
+   * Each channel accumulates four partial sums, which allows the compiler to vectorize the loop.
+   */
+  auto Convolve(float const* kernel) -> T {
+    float const* taps = &history[history_end - points];
+    float sum[s_channels][4] {};
+
+    for (int n = 0; n < points; n += 4) {
+      for (int i = 0; i < 4; i++) {
+        for (int channel = 0; channel < s_channels; channel++) {
+          sum[channel][i] += taps[channel * s_history_length + n + i] * kernel[n + i];
+        }
+      }
+    }
+
+    float result[s_channels];
+
+    for (int channel = 0; channel < s_channels; channel++) {
+      result[channel] = (sum[channel][0] + sum[channel][1]) + (sum[channel][2] + sum[channel][3]);
+    }
+
+    if constexpr (s_channels == 1) {
+      return result[0];
+    } else {
+      return { result[0], result[1] };
+    }
+  }
 
-  double lut[points * s_lut_resolution];
+  std::shared_ptr<float const[]> lut;
+  float lut_cutoff;
+  std::unique_ptr<float[]> history;
+  int history_end;
   float resample_phase = 0;
-  RingBuffer<T> taps { points };
 };
 
 template <typename T, int points>
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "stereo.hpp"
+#include "stream.hpp"
+
+namespace common::dsp {
+
+/* Wait-free ring buffer for exactly one producer thread and one consumer thread.
+ * Written values only become visible to the consumer after Flush(),
+ * which allows the producer to publish a whole block of samples at once.
+ * Values that do not fit into the buffer are dropped.
+ */
+template <typename T>
+class SPSCRingBuffer : public WriteStream<T> {
+public:
+  SPSCRingBuffer(int min_length) {
+    length = 1;
+    while (length < std::size_t(min_length)) {
+      length *= 2;
+    }
+    mask = length - 1;
+    data = std::make_unique<T[]>(length);
+  }
+
+  // Producer
+
+  void Write(T const& value) final {
+    if (wr_pending - rd_cached == length) {
+      rd_cached = rd_ptr.load(std::memory_order_acquire);
+      if (wr_pending - rd_cached == length) {
+        return;
+      }
+    }
+    data[wr_pending & mask] = value;
+    wr_pending++;
+  }
+
+  void Flush() {
+    wr_ptr.store(wr_pending, std::memory_order_release);
+  }
+
+  // Consumer
+
+  auto Available() -> int {
+    return int(wr_ptr.load(std::memory_order_acquire) - rd_ptr.load(std::memory_order_relaxed));
+  }
+
+  auto Peek(int offset) -> T {
+    return data[(rd_ptr.load(std::memory_order_relaxed) + offset) & mask];
+  }
+
+  auto Read(T* values, int count) -> int {
+    auto rd = rd_ptr.load(std::memory_order_relaxed);
+
+    count = std::min(count, Available());
+
+    for (int i = 0; i < count; i++) {
+      values[i] = data[(rd + i) & mask];
+    }
+
+    rd_ptr.store(rd + count, std::memory_order_release);
+    return count;
+  }
+
+private:
+  std::unique_ptr<T[]> data;
+  std::size_t length;
+  std::size_t mask;
+
+  // Only accessed by the producer.
+  std::size_t wr_pending = 0;
+  std::size_t rd_cached = 0;
+
+  alignas(64) std::atomic<std::size_t> wr_ptr {0};
+  alignas(64) std::atomic<std::size_t> rd_ptr {0};
+};
+
+template <typename T>
+using StereoSPSCRingBuffer = SPSCRingBuffer<StereoSample<T>>;
+
+} // namespace common::dsp
@@ -5,6 +5,16 @@
  * Refer to the included LICENSE file.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "log.hpp"
 
 #ifdef WIN32
@@ -14,19 +24,248 @@
 
 namespace common::logger {
 
-auto trim_filepath(const char* file) -> std::string {
-  auto tmp = std::string{file};
+namespace {
+
+struct Entry {
+  static constexpr size_t kMaxLength = 384;
+
+  Level level;
+  const char* file;
+  const char* function;
+  int line;
+  // Only set when the sink differs from that of the previous entry, see Queue::sink.
+  std::shared_ptr<Sink> sink;
+  size_t length;
+  char text[kMaxLength];
+};
+
+// Wait-free queue between one logging thread and the logger thread.
+struct Queue {
+  static constexpr size_t kCapacity = 64;
+
+  Entry entries[kCapacity];
+  std::atomic<size_t> wr_ptr {0};
+  std::atomic<size_t> rd_ptr {0};
+
+  // Set once the logging thread has exited, the queue is removed after it has been drained.
+  std::atomic<bool> closed {false};
+
+  /* The sink of the last drained entry (only accessed by the logger thread).
+   * The logging thread passes the sink along with the first entry that uses it,
+   * so that logging to the same sink does not touch its shared reference count.
+   */
+  std::shared_ptr<Sink> sink;
+};
+
+class Logger {
+public:
+  Logger() {
+    thread = std::thread{&Logger::ThreadMain, this};
+  }
+
+  auto CreateQueue() -> std::shared_ptr<Queue> {
+    auto queue = std::make_shared<Queue>();
+    std::lock_guard<std::mutex> guard(mutex);
+    queues.push_back(queue);
+    return queue;
+  }
+
+  // Threads cache the default sink, until the generation changes.
+  auto GetDefaultSinkGeneration() const -> std::uint64_t {
+    return default_sink_generation.load(std::memory_order_acquire);
+  }
+
+  auto GetDefaultSink(std::uint64_t& generation) -> std::shared_ptr<Sink> {
+    std::lock_guard<std::mutex> guard(mutex);
+    generation = default_sink_generation.load();
+    return default_sink;
+  }
+
+  void SetDefaultSink(std::shared_ptr<Sink> sink) {
+    std::lock_guard<std::mutex> guard(mutex);
+    default_sink = std::move(sink);
+    default_sink_generation++;
+  }
+
+  void Notify() {
+    wakeup = true;
+    cv.notify_one();
+  }
+
+  // Waits until the logger thread has completed a whole pass that started after this call.
+  void Flush() {
+    std::unique_lock<std::mutex> lock{mutex};
+    auto target = passes + 2;
+
+    if (quit) {
+      return;
+    }
+    wakeup = true;
+    cv.notify_one();
+    cv_flush.wait(lock, [&] { return passes >= target || quit; });
+  }
+
+  void Shutdown() {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      quit = true;
+    }
+    cv.notify_one();
+    thread.join();
+  }
+
+  bool IsRunning() const {
+    return !quit.load(std::memory_order_acquire);
+  }
+
+private:
+  void ThreadMain() {
+    std::vector<std::shared_ptr<Queue>> snapshot;
+    std::vector<std::shared_ptr<Sink>> written;
+    std::unique_lock<std::mutex> lock{mutex};
+
+    while (true) {
+      /* Logging threads notify without holding the mutex, so a notification may get lost.
+       * The timeout bounds the latency in that case.
+       */
+      cv.wait_for(lock, std::chrono::milliseconds(10), [this] { return quit || wakeup; });
+
+      bool exit = quit;
+      wakeup = false;
+      snapshot = queues;
+      lock.unlock();
+
+      for (auto& queue : snapshot) {
+        Drain(*queue, written);
+      }
+      for (auto& sink : written) {
+        sink->Flush();
+      }
+      written.clear();
+
+      lock.lock();
+
+      // A closed queue may only be removed once its final messages have been drained.
+      queues.erase(std::remove_if(queues.begin(), queues.end(), [](auto const& queue) {
+        return queue->closed.load() && queue->rd_ptr.load() == queue->wr_ptr.load();
+      }), queues.end());
+
+      passes++;
+      cv_flush.notify_all();
+
+      if (exit) {
+        break;
+      }
+    }
+  }
+
+  void Drain(Queue& queue, std::vector<std::shared_ptr<Sink>>& written) {
+    auto rd = queue.rd_ptr.load(std::memory_order_relaxed);
+    auto wr = queue.wr_ptr.load(std::memory_order_acquire);
+
+    while (rd != wr) {
+      auto& entry = queue.entries[rd % Queue::kCapacity];
+
+      if (entry.sink) {
+        queue.sink = std::move(entry.sink);
+      }
+      // Keeps the sink alive until it has been flushed, even if the queue moves on to another sink.
+      if (std::find(written.begin(), written.end(), queue.sink) == written.end()) {
+        written.push_back(queue.sink);
+      }
+      queue.sink->Write({entry.level, entry.file, entry.function, entry.line, {entry.text, entry.length}});
+      queue.rd_ptr.store(++rd, std::memory_order_release);
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::condition_variable cv_flush;
+  std::thread thread;
+  std::vector<std::shared_ptr<Queue>> queues;
+  std::shared_ptr<Sink> default_sink = std::make_shared<ConsoleSink>();
+  std::atomic<std::uint64_t> default_sink_generation {1};
+  std::uint64_t passes = 0;
+  std::atomic<bool> wakeup {false};
+  std::atomic<bool> quit {false};
+};
+
+auto GetLogger() -> Logger& {
+  /* The logger is never destroyed, so that it outlives any thread that might still log.
+   * Its thread is stopped at exit, after that messages are written synchronously.
+   */
+  static Logger* logger = [] {
+    auto logger = new Logger();
+    std::atexit([] { GetLogger().Shutdown(); });
+    return logger;
+  }();
+
+  return *logger;
+}
+
+// The state of a logging thread. Marks the queue of the thread as closed when the thread exits.
+struct ThreadState {
+ ~ThreadState() {
+    if (queue) {
+      queue->closed = true;
+    }
+  }
+
+  std::shared_ptr<Queue> queue;
+  Sink* last_sink = nullptr;
+  std::shared_ptr<Sink> default_sink;
+  std::uint64_t default_sink_generation = 0;
+};
+
+thread_local ThreadState t_state;
+thread_local std::shared_ptr<Sink> t_sink;
+
+auto trim_filepath(const char* file) -> std::string_view {
+  auto tmp = std::string_view{file};
 #ifdef WIN32
   auto pos = tmp.find("\\source\\");
 #else
   auto pos = tmp.find("/source/");
 #endif
-  if (pos == std::string::npos) {
+  if (pos == std::string_view::npos) {
     return "???";
   }
   return tmp.substr(pos);
 }
 
+} // namespace
+
+void ConsoleSink::Write(Message const& message) {
+  const char* prefix = "";
+
+  switch (message.level) {
+    case Level::Trace:
+      prefix = "\e[36m[T]";
+      break;
+    case Level::Debug:
+      prefix = "\e[34m[D]";
+      break;
+    case Level::Info:
+      prefix = "\e[37m[I]";
+      break;
+    case Level::Warn:
+      prefix = "\e[33m[W]";
+      break;
+    case Level::Error:
+      prefix = "\e[35m[E]";
+      break;
+    case Level::Fatal:
+      prefix = "\e[31m[F]";
+      break;
+  }
+
+  fmt::print(stream, "{0} {1}:{2} [{3}]: {4}\e[39m\n", prefix, trim_filepath(message.file), message.line, message.function, message.text);
+}
+
+void ConsoleSink::Flush() {
+  std::fflush(stream);
+}
+
 void init() {
 #ifdef WIN32
   // We require ANSI escape sequences for colored output.
@@ -39,7 +278,7 @@ void init() {
       SetConsoleMode(handle, mode);
     }
   }
-  
+
   // Workaround for Mingw-w64 build with no command line window.
   // The application will crash otherwise when flushing to a non-existent stdout.
   // TODO: replace with something less hacky, or at least detect when it's actually necessary.
@@ -50,35 +289,81 @@ void init() {
 #endif
 }
 
-void append(Level level,
-            const char* file,
-            const char* function,
-            int line,
-            std::string const& message) {
-  std::string prefix;
+void set_default_sink(std::shared_ptr<Sink> sink) {
+  GetLogger().SetDefaultSink(std::move(sink));
+}
 
-  switch (level) {
-    case Level::Trace:
-      prefix = "\e[36m[T]";
-      break;
-    case Level::Debug:
-      prefix = "\e[34m[D]";
-      break;
-    case Level::Info:
-      prefix = "\e[37m[I]";
-      break;
-    case Level::Warn:
-      prefix = "\e[33m[W]";
-      break;
-    case Level::Error:
-      prefix = "\e[35m[E]";
-      break;
-    case Level::Fatal:
-      prefix = "\e[31m[F]";
-      break;
+auto set_thread_sink(std::shared_ptr<Sink> sink) -> std::shared_ptr<Sink> {
+  std::swap(t_sink, sink);
+  return sink;
+}
+
+void flush() {
+  GetLogger().Flush();
+}
+
+void vappend(Level level,
+             const char* file,
+             const char* function,
+             int line,
+             fmt::string_view format,
+             fmt::format_args args) {
+  auto& logger = GetLogger();
+  auto& state = t_state;
+
+  if (!t_sink && state.default_sink_generation != logger.GetDefaultSinkGeneration()) {
+    state.default_sink = logger.GetDefaultSink(state.default_sink_generation);
+  }
+
+  auto const& sink = t_sink ? t_sink : state.default_sink;
+
+  fmt::memory_buffer buffer;
+  fmt::vformat_to(std::back_inserter(buffer), format, args);
+
+  auto length = std::min(buffer.size(), Entry::kMaxLength);
+
+  if (!logger.IsRunning()) {
+    sink->Write({level, file, function, line, {buffer.data(), length}});
+    sink->Flush();
+    return;
+  }
+
+  auto& queue = state.queue;
+
+  if (!queue) {
+    queue = logger.CreateQueue();
   }
 
-  fmt::print("{0} {1}:{2} [{3}]: {4}\e[39m\n", prefix, trim_filepath(file), line, function, message);
+  auto wr = queue->wr_ptr.load(std::memory_order_relaxed);
+  auto rd = queue->rd_ptr.load(std::memory_order_acquire);
+
+  // Wait for the logger thread to make room, rather than dropping the message.
+  while (wr - rd == Queue::kCapacity) {
+    logger.Notify();
+    std::this_thread::yield();
+    rd = queue->rd_ptr.load(std::memory_order_acquire);
+  }
+
+  auto& entry = queue->entries[wr % Queue::kCapacity];
+
+  entry.level = level;
+  entry.file = file;
+  entry.function = function;
+  entry.line = line;
+  entry.length = length;
+  std::memcpy(entry.text, buffer.data(), length);
+
+  if (sink.get() != state.last_sink) {
+    entry.sink = sink;
+    state.last_sink = sink.get();
+  }
+
+  queue->wr_ptr.store(wr + 1, std::memory_order_release);
+
+  // The logger thread drains the whole queue once it is awake, so it only has to be woken up for the first message.
+  if (wr == rd) {
+    logger.Notify();
+  }
 }
 
 } // namespace common::logger
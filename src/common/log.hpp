@@ -7,9 +7,18 @@
 
 #pragma once
 
+#include <cstdio>
 #include <cstdlib>
 #include <fmt/format.h>
-#include <string>
+#include <memory>
+#include <string_view>
+
+/* Log statements below this level are compiled out, including the formatting of their message.
+ * 0 = Trace, 1 = Debug, 2 = Info, 3 = Warn, 4 = Error, 5 = Fatal
+ */
+#ifndef NBA_LOG_LEVEL
+  #define NBA_LOG_LEVEL 2
+#endif
 
 namespace common::logger {
 
@@ -22,31 +31,108 @@ enum class Level {
   Fatal
 };
 
+struct Message {
+  Level level;
+  const char* file;
+  const char* function;
+  int line;
+  std::string_view text;
+};
+
+/* Receives the log messages. Messages are passed to the sink on the logger thread,
+ * so a sink only ever is accessed from a single thread.
+ */
+class Sink {
+public:
+  virtual ~Sink() {}
+
+  virtual void Write(Message const& message) = 0;
+
+  // Called after a batch of messages has been written.
+  virtual void Flush() {}
+};
+
+// Prints the messages with ANSI colors, to stdout by default.
+class ConsoleSink : public Sink {
+public:
+  ConsoleSink(std::FILE* stream = stdout) : stream(stream) {}
+
+  void Write(Message const& message) override;
+  void Flush() override;
+
+private:
+  std::FILE* stream;
+};
+
+class NullSink : public Sink {
+public:
+  void Write(Message const& message) override {}
+};
+
 void init();
 
-void append(Level level,
-            const char* file,
-            const char* function,
-            int line,
-            std::string const& message);
+// Sets the sink for all threads that do not have a sink of their own.
+void set_default_sink(std::shared_ptr<Sink> sink);
+
+// Sets the sink of the calling thread (nullptr: the default sink) and returns the previous one.
+auto set_thread_sink(std::shared_ptr<Sink> sink) -> std::shared_ptr<Sink>;
+
+// Sets the sink of the calling thread for the lifetime of the object, unless the sink is nullptr.
+class ScopedSink {
+public:
+  ScopedSink(std::shared_ptr<Sink> const& sink) : active(sink != nullptr) {
+    if (active) {
+      previous = set_thread_sink(sink);
+    }
+  }
 
-#define LOG_TRACE(message, ...) common::logger::append(common::logger::Level::Trace, __FILE__, __func__, __LINE__, \
-                                                       fmt::format(message, ## __VA_ARGS__));
+ ~ScopedSink() {
+    if (active) {
+      set_thread_sink(std::move(previous));
+    }
+  }
 
-#define LOG_DEBUG(message, ...) common::logger::append(common::logger::Level::Debug, __FILE__, __func__, __LINE__, \
-                                                       fmt::format(message, ## __VA_ARGS__));
+private:
+  bool active;
+  std::shared_ptr<Sink> previous;
+};
+
+// Blocks until all messages that were logged so far have been written.
+void flush();
 
-#define LOG_INFO(message, ...) common::logger::append(common::logger::Level::Info, __FILE__, __func__, __LINE__, \
-                                                      fmt::format(message, ## __VA_ARGS__));
+/* The message is formatted right away, but written to the sink by a background thread.
+ * Each thread logs into its own lock-free queue, so that threads do not wait on each other.
+ */
+void vappend(Level level,
+             const char* file,
+             const char* function,
+             int line,
+             fmt::string_view format,
+             fmt::format_args args);
 
-#define LOG_WARN(message, ...) common::logger::append(common::logger::Level::Warn, __FILE__, __func__, __LINE__, \
-                                                      fmt::format(message, ## __VA_ARGS__));
+template<typename... Args>
+void append(Level level,
+            const char* file,
+            const char* function,
+            int line,
+            fmt::string_view format,
+            Args const&... args) {
+  vappend(level, file, function, line, format, fmt::make_format_args(args...));
+}
 
-#define LOG_ERROR(message, ...) common::logger::append(common::logger::Level::Error, __FILE__, __func__, __LINE__, \
-                                                       fmt::format(message, ## __VA_ARGS__));
+#define NBA_LOG(level, message, ...) \
+  do { \
+    if constexpr (int(level) >= NBA_LOG_LEVEL) { \
+      common::logger::append(level, __FILE__, __func__, __LINE__, message, ## __VA_ARGS__); \
+    } \
+  } while (0)
 
-#define LOG_FATAL(message, ...) common::logger::append(logger::detail::Level::Fatal, __FILE__, __func__, __LINE__, \
-                                                       fmt::format(message, ## __VA_ARGS__));
+#define LOG_TRACE(message, ...) NBA_LOG(common::logger::Level::Trace, message, ## __VA_ARGS__);
+#define LOG_DEBUG(message, ...) NBA_LOG(common::logger::Level::Debug, message, ## __VA_ARGS__);
+#define LOG_INFO(message, ...)  NBA_LOG(common::logger::Level::Info,  message, ## __VA_ARGS__);
+#define LOG_WARN(message, ...)  NBA_LOG(common::logger::Level::Warn,  message, ## __VA_ARGS__);
+#define LOG_ERROR(message, ...) NBA_LOG(common::logger::Level::Error, message, ## __VA_ARGS__);
+#define LOG_FATAL(message, ...) NBA_LOG(common::logger::Level::Fatal, message, ## __VA_ARGS__);
 
 #define ASSERT(condition, message, ...) if (!(condition)) { LOG_ERROR(message, ## __VA_ARGS__); std::exit(-1); }
 
@@ -5,6 +5,7 @@
 #include <cstdint>
 
 static constexpr int kM4AMaxDirectSoundChannels = 12;
+static constexpr std::uint32_t kM4ASoundInfoMagic = 0x68736D53;
 
 using u32ptr_t = std::uint32_t;
 
@@ -46,6 +47,15 @@ struct M4ASoundChannel {
   std::uint16_t xpc;
 };
 
+struct M4AWaveData {
+  std::uint16_t type;
+  std::uint16_t status;
+  std::uint32_t freq;
+  std::uint32_t loopStart;
+  std::uint32_t size;
+  /* followed by the signed 8-bit samples */
+};
+
 struct M4ASoundInfo {
   std::uint32_t magic;
   volatile std::uint8_t pcmDmaCounter;
@@ -12,29 +12,45 @@
 #endif
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <emulator/config/config.hpp>
 #include <experimental/filesystem>
 #include <cstdint>
 #include <cstring>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <fstream>
 #include <memory>
+#include <thread>
 #include <vector>
 
 namespace nba {
 
 class BackupFile {
 public:
+  using SaveMode = Config::SaveMode;
 
   static auto OpenOrCreate(std::string const& save_path,
                            std::vector<size_t> const& valid_sizes,
-                           int& default_size) -> std::unique_ptr<BackupFile> {
+                           int& default_size,
+                           Config const& config) -> std::unique_ptr<BackupFile> {
     namespace fs = std::experimental::filesystem;
 
     bool create = true;
     auto flags = std::ios::binary | std::ios::in | std::ios::out;
     std::unique_ptr<BackupFile> file { new BackupFile() };
 
+    file->mode = config.save_mode;
+
+    /* An ephemeral save is initialized from an existing save file,
+     * but the file is never created or written to.
+     */
+    if (file->mode == SaveMode::Ephemeral) {
+      flags = std::ios::binary | std::ios::in;
+    }
+
     /* TODO: check file type and permissions? */
     if (fs::is_regular_file(save_path)) {
       auto size = fs::file_size(save_path);
@@ -55,22 +71,42 @@ public:
     }
 
     file->file_size = default_size;
+    file->dirty_pages.resize((default_size + s_page_size - 1) / s_page_size);
 
     /* A new save file is created either when no file exists yet,
      * or when the existing file has an invalid size.
      */
     if (create) {
-      file->stream.open(save_path, flags | std::ios::trunc);
-      if (file->stream.fail()) {
-        throw std::runtime_error("BackupFile: unable to create file: " + save_path);
+      if (file->mode != SaveMode::Ephemeral) {
+        file->stream.open(save_path, flags | std::ios::trunc);
+        if (file->stream.fail()) {
+          throw std::runtime_error("BackupFile: unable to create file: " + save_path);
+        }
       }
       file->memory.reset(new std::uint8_t[default_size]);
       file->MemorySet(0, default_size, 0xFF);
     }
 
+    if (file->mode == SaveMode::Deferred && config.save_flush_interval > 0) {
+      file->flush_thread = std::thread{&BackupFile::FlushThreadMain, file.get(), config.save_flush_interval};
+    }
+
     return file;
   }
 
+  ~BackupFile() {
+    if (flush_thread.joinable()) {
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+        quit = true;
+      }
+      cv_quit.notify_one();
+      flush_thread.join();
+    }
+
+    Flush();
+  }
+
   auto Read(unsigned index) -> std::uint8_t {
     if (index >= file_size) {
       throw std::runtime_error("BackupFile: out-of-bounds index while reading.");
@@ -82,8 +118,14 @@ public:
     if (index >= file_size) {
       throw std::runtime_error("BackupFile: out-of-bounds index while writing.");
     }
+    if (mode == SaveMode::Deferred) {
+      std::lock_guard<std::mutex> guard(mutex);
+      memory[index] = value;
+      MarkDirty(index, 1);
+      return;
+    }
     memory[index] = value;
-    if (auto_update) {
+    if (auto_update && mode == SaveMode::Immediate) {
       Update(index, 1);
     }
   }
@@ -92,8 +134,14 @@ public:
     if ((index + length) > file_size) {
       throw std::runtime_error("BackupFile: out-of-bounds index while setting memory.");
     }
+    if (mode == SaveMode::Deferred) {
+      std::lock_guard<std::mutex> guard(mutex);
+      std::memset(&memory[index], value, length);
+      MarkDirty(index, length);
+      return;
+    }
     std::memset(&memory[index], value, length);
-    if (auto_update) {
+    if (auto_update && mode == SaveMode::Immediate) {
       Update(index, length);
     }
   }
@@ -106,14 +154,97 @@ public:
     stream.write((char*)&memory[index], length);
   }
 
+  // Writes all deferred changes to the save file.
+  void Flush() {
+    if (mode != SaveMode::Deferred) {
+      return;
+    }
+
+    std::vector<std::pair<unsigned, std::vector<std::uint8_t>>> ranges;
+
+    /* Take a copy of the dirty ranges, so that the emulator
+     * does not have to wait for the file I/O to complete.
+     */
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+
+      if (!dirty) {
+        return;
+      }
+
+      size_t page = 0;
+      size_t page_count = dirty_pages.size();
+
+      while (page < page_count) {
+        if (!dirty_pages[page]) {
+          page++;
+          continue;
+        }
+
+        size_t first = page;
+        while (page < page_count && dirty_pages[page]) {
+          dirty_pages[page++] = false;
+        }
+
+        auto begin = first * s_page_size;
+        auto end = std::min(page * s_page_size, file_size);
+        ranges.emplace_back(begin, std::vector<std::uint8_t>{&memory[begin], &memory[end]});
+      }
+
+      dirty = false;
+    }
+
+    for (auto const& [index, data] : ranges) {
+      stream.seekp(index);
+      stream.write((char*)data.data(), data.size());
+    }
+    stream.flush();
+  }
+
   bool auto_update = true;
 
 private:
+  static constexpr size_t s_page_size = 256;
+
   BackupFile() { }
 
+  void MarkDirty(unsigned index, size_t length) {
+    if (length == 0) {
+      return;
+    }
+    auto first = index / s_page_size;
+    auto last = (index + length - 1) / s_page_size;
+    for (auto page = first; page <= last; page++) {
+      dirty_pages[page] = true;
+    }
+    dirty = true;
+  }
+
+  void FlushThreadMain(int interval) {
+    std::unique_lock<std::mutex> lock{mutex};
+
+    while (!cv_quit.wait_for(lock, std::chrono::milliseconds(interval), [this] { return quit; })) {
+      lock.unlock();
+      Flush();
+      lock.lock();
+    }
+  }
+
   size_t file_size;
   std::fstream stream;
   std::unique_ptr<std::uint8_t[]> memory;
+
+  SaveMode mode = SaveMode::Immediate;
+
+  /* State of deferred saves. The mutex guards the memory, the dirty pages and the quit flag,
+   * the save file is only accessed by the flush thread (or on destruction).
+   */
+  std::mutex mutex;
+  std::condition_variable cv_quit;
+  std::thread flush_thread;
+  std::vector<bool> dirty_pages;
+  bool dirty = false;
+  bool quit = false;
 };
 
 } // namespace nba
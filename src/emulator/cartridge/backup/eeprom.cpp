@@ -15,9 +15,10 @@ namespace nba {
 static constexpr int g_addr_bits[2] = { 6, 14 };
 static constexpr int g_save_size[2] = { 512, 8192 };
 
-EEPROM::EEPROM(std::string const& save_path, Size size_hint)
+EEPROM::EEPROM(std::string const& save_path, Size size_hint, std::shared_ptr<Config> config)
   : size(size_hint)
   , save_path(save_path)
+  , config(config)
   
 {
   Reset();
@@ -30,7 +31,7 @@ void EEPROM::Reset() {
 
   int bytes = g_save_size[size];
   
-  file = BackupFile::OpenOrCreate(save_path, { 512, 8192 }, bytes);
+  file = BackupFile::OpenOrCreate(save_path, { 512, 8192 }, bytes, *config);
   if (bytes == g_save_size[0]) {
     size = SIZE_4K;
   } else {
@@ -21,7 +21,7 @@ public:
     SIZE_64K = 1
   };
   
-  EEPROM(std::string const& save_path, Size size_hint);
+  EEPROM(std::string const& save_path, Size size_hint, std::shared_ptr<Config> config);
   
   void Reset() final;
   auto Read (std::uint32_t address) -> std::uint8_t final;
@@ -43,6 +43,7 @@ private:
   
   int size;
   std::string save_path;
+  std::shared_ptr<Config> config;
   std::unique_ptr<BackupFile> file;
 
   int state;
@@ -11,9 +11,10 @@ namespace nba {
 
 static constexpr int g_save_size[2] = { 65536, 131072 };
 
-FLASH::FLASH(std::string const& save_path, Size size_hint)
+FLASH::FLASH(std::string const& save_path, Size size_hint, std::shared_ptr<Config> config)
   : size(size_hint)
   , save_path(save_path)
+  , config(config)
 {
   Reset();
 }
@@ -28,7 +29,7 @@ void FLASH::Reset() {
   
   int bytes = g_save_size[size];
   
-  file = BackupFile::OpenOrCreate(save_path, { 65536, 131072 }, bytes);
+  file = BackupFile::OpenOrCreate(save_path, { 65536, 131072 }, bytes, *config);
   if (bytes == g_save_size[0]) {
     size = SIZE_64K;
   } else {
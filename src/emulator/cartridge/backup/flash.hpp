@@ -21,7 +21,7 @@ public:
     SIZE_128K = 1
   };
   
-  FLASH(std::string const& save_path, Size size_hint);
+  FLASH(std::string const& save_path, Size size_hint, std::shared_ptr<Config> config);
   
   void Reset() final;
   auto Read (std::uint32_t address) -> std::uint8_t final;
@@ -46,6 +46,7 @@ private:
   
   Size size;
   std::string save_path;
+  std::shared_ptr<Config> config;
   std::unique_ptr<BackupFile> file;
   
   int current_bank;
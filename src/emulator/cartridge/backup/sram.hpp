@@ -16,14 +16,15 @@ namespace nba {
 
 class SRAM : public Backup {
 public:
-  SRAM(std::string const& save_path)
-    : save_path(save_path) {
+  SRAM(std::string const& save_path, std::shared_ptr<Config> config)
+    : save_path(save_path)
+    , config(config) {
     Reset();
   }
   
   void Reset() final {
     int bytes = 32768;
-    file = BackupFile::OpenOrCreate(save_path, { 32768 }, bytes);
+    file = BackupFile::OpenOrCreate(save_path, { 32768 }, bytes, *config);
   }
   
   auto Read(std::uint32_t address) -> std::uint8_t final {
@@ -36,6 +37,7 @@ public:
   
 private:
   std::string save_path;
+  std::shared_ptr<Config> config;
   std::unique_ptr<BackupFile> file;
 };
 
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2020 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <cstring>
+#include <initializer_list>
+#include <mutex>
+#include <unordered_map>
+
+#include "rom_scan.hpp"
+
+namespace nba {
+
+namespace {
+
+struct Pattern {
+  Pattern(std::initializer_list<int> bytes, int alignment)
+      : bytes(bytes)
+      , alignment(alignment) {
+  }
+
+  Pattern(char const* string, int alignment)
+      : bytes(string, string + std::strlen(string))
+      , alignment(alignment) {
+  }
+
+  // -1 matches any byte. The first two bytes must not be wildcards.
+  std::vector<int> bytes;
+  int alignment;
+};
+
+using BackupType = Config::BackupType;
+
+constexpr BackupType g_backup_types[] {
+  BackupType::EEPROM_64,
+  BackupType::SRAM,
+  BackupType::SRAM,
+  BackupType::FLASH_64,
+  BackupType::FLASH_64,
+  BackupType::FLASH_128
+};
+
+constexpr int g_backup_pattern_count = sizeof(g_backup_types) / sizeof(BackupType);
+
+enum PatternID {
+  PATTERN_M4A_SAMPLE_FREQ_SET = g_backup_pattern_count,
+  PATTERN_M4A_SOUND_MAIN,
+  PATTERN_COUNT
+};
+
+const Pattern g_patterns[PATTERN_COUNT] {
+  // Backup library strings, the order matches g_backup_types.
+  { "EEPROM_V",   4 },
+  { "SRAM_V",     4 },
+  { "SRAM_F_V",   4 },
+  { "FLASH_V",    4 },
+  { "FLASH512_V", 4 },
+  { "FLASH1M_V",  4 },
+
+  // M4A SampleFreqSet(), preceded by the engine's "Smsh" ident.
+  { {
+    0x53, 0x6D, 0x73, 0x68, 0x70, 0xB5, 0x02, 0x1C,
+    0x1E, 0x48, 0x04, 0x68, 0xF0, 0x20, 0x00, 0x03,
+    0x10, 0x40, 0x02, 0x0C
+  }, 1 },
+
+  // M4A SoundMain() up to the point where its stack frame has been set up.
+  { {
+    0x00, 0x68, -1,   0x4A, 0x03, 0x68, 0x9A, 0x42,
+    0x00, 0xD0, 0x70, 0x47, 0x01, 0x33, 0x03, 0x60,
+    0xF0, 0xB5, 0x41, 0x46, 0x4A, 0x46, 0x53, 0x46,
+    0x5C, 0x46, 0x1F, 0xB4, 0x86, 0xB0
+  }, 2 }
+};
+
+static_assert(PATTERN_COUNT <= 16, "ScanROM: too many patterns for the prefix filter.");
+
+/* Finds all matches of all patterns in a single pass over the ROM.
+ * The patterns are indexed by their first two bytes, so that most offsets are rejected with a single table lookup.
+ */
+void Scan(std::uint8_t const* rom, size_t size, std::vector<std::uint32_t> (&matches)[PATTERN_COUNT]) {
+  auto filter = std::make_unique<std::uint16_t[]>(0x10000);
+
+  for (int id = 0; id < PATTERN_COUNT; id++) {
+    auto const& bytes = g_patterns[id].bytes;
+    filter[bytes[0] | (bytes[1] << 8)] |= 1 << id;
+  }
+
+  for (size_t i = 0; i + 1 < size; i++) {
+    unsigned candidates = filter[rom[i] | (rom[i + 1] << 8)];
+
+    while (candidates != 0) {
+      int id = __builtin_ctz(candidates);
+      auto const& pattern = g_patterns[id];
+      auto const& bytes = pattern.bytes;
+
+      candidates &= candidates - 1;
+
+      if ((i % pattern.alignment) != 0 || i + bytes.size() > size) {
+        continue;
+      }
+
+      bool match = true;
+      for (size_t j = 2; j < bytes.size(); j++) {
+        if (bytes[j] != -1 && rom[i + j] != bytes[j]) {
+          match = false;
+          break;
+        }
+      }
+
+      if (match) {
+        matches[id].push_back(i);
+      }
+    }
+  }
+}
+
+} // namespace
+
+auto HashROM(std::uint8_t const* data, size_t size) -> std::uint64_t {
+  static constexpr std::uint64_t kPrime = 0x9E3779B97F4A7C15ULL;
+
+  // Four independent lanes, so that the multiplications can overlap.
+  std::uint64_t lanes[4] { size, size + 1, size + 2, size + 3 };
+
+  size_t i = 0;
+
+  for (; i + 32 <= size; i += 32) {
+    std::uint64_t words[4];
+    std::memcpy(words, &data[i], sizeof(words));
+    for (int lane = 0; lane < 4; lane++) {
+      lanes[lane] = (lanes[lane] ^ words[lane]) * kPrime;
+      lanes[lane] ^= lanes[lane] >> 29;
+    }
+  }
+
+  std::uint64_t hash = lanes[0];
+  for (int lane = 1; lane < 4; lane++) {
+    hash = (hash ^ lanes[lane]) * kPrime;
+  }
+  for (; i < size; i++) {
+    hash = (hash ^ data[i]) * kPrime;
+  }
+  return hash ^ (hash >> 29);
+}
+
+auto ScanROM(std::uint8_t const* rom, size_t size) -> std::shared_ptr<ROMScanResult const> {
+  static std::mutex mutex;
+  static std::unordered_map<std::uint64_t, std::shared_ptr<ROMScanResult const>> cache;
+
+  auto hash = HashROM(rom, size);
+
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (auto match = cache.find(hash); match != cache.end()) {
+      return match->second;
+    }
+  }
+
+  std::vector<std::uint32_t> matches[PATTERN_COUNT];
+  auto result = std::make_shared<ROMScanResult>();
+
+  result->hash = hash;
+
+  Scan(rom, size, matches);
+
+  // The first backup library string decides the backup type.
+  std::uint32_t backup_offset = ~0U;
+  for (int id = 0; id < g_backup_pattern_count; id++) {
+    if (!matches[id].empty() && matches[id][0] < backup_offset) {
+      backup_offset = matches[id][0];
+      result->backup_type = g_backup_types[id];
+    }
+  }
+
+  result->m4a_sample_freq_set = std::move(matches[PATTERN_M4A_SAMPLE_FREQ_SET]);
+  result->m4a_sound_main = std::move(matches[PATTERN_M4A_SOUND_MAIN]);
+
+  std::lock_guard<std::mutex> guard(mutex);
+  cache[hash] = result;
+  return result;
+}
+
+} // namespace nba
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2020 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <emulator/config/config.hpp>
+#include <memory>
+#include <vector>
+
+namespace nba {
+
+/* Locations of SDK signatures in a ROM. All signatures are searched for in a single pass
+ * when the ROM is loaded and the result is cached by the hash of the ROM.
+ */
+struct ROMScanResult {
+  // Hash of the ROM contents, see HashROM().
+  std::uint64_t hash = 0;
+
+  // Backup type indicated by the first SDK backup library string.
+  Config::BackupType backup_type = Config::BackupType::Detect;
+
+  // Offsets of the M4A routines, in ascending order.
+  std::vector<std::uint32_t> m4a_sample_freq_set;
+  std::vector<std::uint32_t> m4a_sound_main;
+};
+
+// Hashes a ROM (or the BIOS) to identify it in caches. This is not a cryptographic hash.
+auto HashROM(std::uint8_t const* data, size_t size) -> std::uint64_t;
+
+auto ScanROM(std::uint8_t const* rom, size_t size) -> std::shared_ptr<ROMScanResult const>;
+
+} // namespace nba
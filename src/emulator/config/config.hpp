@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <common/log.hpp>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -22,6 +23,11 @@ struct Config {
   
   bool skip_bios = false;
   bool sync_to_audio = false;
+
+  /* Directory in which the state after the BIOS intro is stored for each BIOS and ROM.
+   * Later boots of the same game continue from there instead of running the BIOS (empty: disabled).
+   */
+  std::string boot_cache_path = "";
   
   enum class BackupType {
     Detect,
@@ -32,12 +38,32 @@ struct Config {
     EEPROM_4,
     EEPROM_64
   } backup_type = BackupType::Detect;
+
+  /* Controls when writes to the backup memory reach the save file.
+   * Deferred saves are flushed in the background every save_flush_interval milliseconds (zero: on exit only),
+   * ephemeral saves are never written back.
+   */
+  enum class SaveMode {
+    Immediate,
+    Deferred,
+    Ephemeral
+  } save_mode = SaveMode::Immediate;
+
+  int save_flush_interval = 1000;
   
   bool force_rtc = false;
 
   struct Video {
     bool fullscreen = false;
     int scale = 2;
+    enum class RenderMode {
+      Inline,
+      Threaded,
+      Stripes
+    } render_mode = RenderMode::Inline;
+    int render_stripes = 4;
+    // Indexed8 falls back to BGR555 for frames with more than 256 colors.
+    PixelFormat pixel_format = PixelFormat::ARGB8888;
     struct Shader {
       std::string path_vs = "";
       std::string path_fs = "";
@@ -55,11 +81,16 @@ struct Config {
     } interpolation = Interpolation::Cosine;
     bool interpolate_fifo = true;
     bool m4a_xq_enable = false;
+    bool m4a_hle_enable = false;
+    bool dynamic_rate_control = false;
   } audio;
   
   std::shared_ptr<AudioDevice> audio_dev = std::make_shared<NullAudioDevice>();
   std::shared_ptr<InputDevice> input_dev = std::make_shared<NullInputDevice>();
   std::shared_ptr<VideoDevice> video_dev = std::make_shared<NullVideoDevice>();
+
+  // Receives the log messages of the emulator instance (nullptr: the default sink).
+  std::shared_ptr<common::logger::Sink> log_sink;
 };
 
 } // namespace nba
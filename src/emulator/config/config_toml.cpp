@@ -43,6 +43,7 @@ void config_toml_read(Config& config, std::string const& path) {
       auto general = general_result.unwrap();
       config.bios_path = toml::find_or<std::string>(general, "bios_path", "bios.bin");
       config.skip_bios = toml::find_or<toml::boolean>(general, "bios_skip", false);
+      config.boot_cache_path = toml::find_or<std::string>(general, "boot_cache_path", "");
       config.sync_to_audio = toml::find_or<toml::boolean>(general, "sync_to_audio", true);
     }
   }
@@ -74,6 +75,25 @@ void config_toml_read(Config& config, std::string const& path) {
       }
 
       config.force_rtc = toml::find_or<toml::boolean>(cartridge, "force_rtc", false);
+
+      auto save_mode = toml::find_or<std::string>(cartridge, "save_mode", "immediate");
+
+      const std::map<std::string, Config::SaveMode> save_modes{
+        { "immediate", Config::SaveMode::Immediate },
+        { "deferred",  Config::SaveMode::Deferred  },
+        { "ephemeral", Config::SaveMode::Ephemeral }
+      };
+
+      auto save_mode_match = save_modes.find(save_mode);
+
+      if (save_mode_match == save_modes.end()) {
+        LOG_WARN("Save mode '{0}' is not valid, defaulting to immediate.", save_mode);
+        config.save_mode = Config::SaveMode::Immediate;
+      } else {
+        config.save_mode = save_mode_match->second;
+      }
+
+      config.save_flush_interval = toml::find_or<int>(cartridge, "save_flush_interval", 1000);
     }
   }
 
@@ -84,6 +104,26 @@ void config_toml_read(Config& config, std::string const& path) {
       auto video = video_result.unwrap();
       config.video.fullscreen = toml::find_or<toml::boolean>(video, "fullscreen", false);
       config.video.scale = toml::find_or<int>(video, "scale", 2);
+
+      auto render_mode = toml::find_or<std::string>(video, "render_mode", "inline");
+
+      const std::map<std::string, Config::Video::RenderMode> render_modes{
+        { "inline",   Config::Video::RenderMode::Inline   },
+        { "threaded", Config::Video::RenderMode::Threaded },
+        { "stripes",  Config::Video::RenderMode::Stripes  }
+      };
+
+      auto match = render_modes.find(render_mode);
+
+      if (match == render_modes.end()) {
+        LOG_WARN("Render mode '{0}' is not valid, defaulting to inline rendering.", render_mode);
+        config.video.render_mode = Config::Video::RenderMode::Inline;
+      } else {
+        config.video.render_mode = match->second;
+      }
+
+      config.video.render_stripes = toml::find_or<int>(video, "render_stripes", 4);
+
       config.video.shader.path_vs = toml::find_or<std::string>(video, "shader_vs", "");
       config.video.shader.path_fs = toml::find_or<std::string>(video, "shader_fs", "");
     }
@@ -115,6 +155,8 @@ void config_toml_read(Config& config, std::string const& path) {
 
       config.audio.interpolate_fifo = toml::find_or<toml::boolean>(audio, "interpolate_fifo", true);
       config.audio.m4a_xq_enable = toml::find_or<toml::boolean>(audio, "m4a_xq_enable", false);
+      config.audio.m4a_hle_enable = toml::find_or<toml::boolean>(audio, "m4a_hle_enable", false);
+      config.audio.dynamic_rate_control = toml::find_or<toml::boolean>(audio, "dynamic_rate_control", false);
     }
   }
 }
@@ -134,6 +176,7 @@ void config_toml_write(Config& config, std::string const& path) {
   // General
   data["general"]["bios_path"] = config.bios_path;
   data["general"]["bios_skip"] = config.skip_bios;
+  data["general"]["boot_cache_path"] = config.boot_cache_path;
   data["general"]["sync_to_audio"] = config.sync_to_audio;
 
   // Cartridge
@@ -149,10 +192,26 @@ void config_toml_write(Config& config, std::string const& path) {
   }
   data["cartridge"]["save_type"] = save_type;
   data["cartridge"]["force_rtc"] = config.force_rtc;
+  std::string save_mode;
+  switch (config.save_mode) {
+    case Config::SaveMode::Immediate: save_mode = "immediate"; break;
+    case Config::SaveMode::Deferred:  save_mode = "deferred"; break;
+    case Config::SaveMode::Ephemeral: save_mode = "ephemeral"; break;
+  }
+  data["cartridge"]["save_mode"] = save_mode;
+  data["cartridge"]["save_flush_interval"] = config.save_flush_interval;
 
   // Video
   data["video"]["fullscreen"] = config.video.fullscreen;
   data["video"]["scale"] = config.video.scale;
+  std::string render_mode;
+  switch (config.video.render_mode) {
+    case Config::Video::RenderMode::Inline:   render_mode = "inline"; break;
+    case Config::Video::RenderMode::Threaded: render_mode = "threaded"; break;
+    case Config::Video::RenderMode::Stripes:  render_mode = "stripes"; break;
+  }
+  data["video"]["render_mode"] = render_mode;
+  data["video"]["render_stripes"] = config.video.render_stripes;
   data["video"]["shader_vs"] = config.video.shader.path_vs;
   data["video"]["shader_fs"] = config.video.shader.path_fs;
 
@@ -168,6 +227,8 @@ void config_toml_write(Config& config, std::string const& path) {
   data["audio"]["resampler"] = resampler;
   data["audio"]["interpolate_fifo"] = config.audio.interpolate_fifo;
   data["audio"]["m4a_xq_enable"] = config.audio.m4a_xq_enable;
+  data["audio"]["m4a_hle_enable"] = config.audio.m4a_hle_enable;
+  data["audio"]["dynamic_rate_control"] = config.audio.dynamic_rate_control;
 
   std::ofstream file{ path, std::ios::out };
   file << data;
@@ -41,10 +41,23 @@ public:
     cpu_mode_is_invalid = false;
   }
 
+  struct Pipeline {
+    Access fetch_type;
+    std::uint32_t opcode[2];
+  };
+
   auto GetPrefetchedOpcode(int slot) -> std::uint32_t {
     return pipe.opcode[slot];
   }
 
+  auto GetPipeline() const -> Pipeline const& {
+    return pipe;
+  }
+
+  void SetPipeline(Pipeline const& pipeline) {
+    pipe = pipeline;
+  }
+
   bool code = false;
 
   void Run() {
@@ -117,6 +130,19 @@ public:
     cpu_mode_is_invalid = new_bank == BANK_INVALID;
   }
 
+  // Jumps to the given address like BX does, bit 0 selects Thumb or ARM state.
+  void BranchExchange(std::uint32_t address) {
+    if (address & 1) {
+      state.cpsr.f.thumb = 1;
+      state.r15 = address & ~1;
+      ReloadPipeline16();
+    } else {
+      state.cpsr.f.thumb = 0;
+      state.r15 = address & ~3;
+      ReloadPipeline32();
+    }
+  }
+
   RegisterFile state;
 
   typedef void (ARM7TDMI::*Handler16)(std::uint16_t);
@@ -258,10 +284,7 @@ private:
   bool ldm_usermode_conflict;
   bool cpu_mode_is_invalid;
 
-  struct Pipeline {
-    Access fetch_type;
-    std::uint32_t opcode[2];
-  } pipe;
+  Pipeline pipe;
 
   bool irq_line;
 
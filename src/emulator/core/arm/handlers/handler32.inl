@@ -628,7 +628,7 @@ void ARM_BlockDataTransfer(std::uint32_t instruction) {
        * register accesses will go to both the user bank and original bank.
        */
       ldm_usermode_conflict = true;
-      scheduler.Add(2, [this](int late) {
+      scheduler.Add(2, EventClass::CPU, [this](int late) {
         ldm_usermode_conflict = false;
       });
     }
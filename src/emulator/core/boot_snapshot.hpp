@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include "arm/arm7tdmi.hpp"
+#include "hw/ppu/ppu.hpp"
+
+namespace nba::core {
+
+/* State of the system at the first instruction of the game, after the BIOS intro has run.
+ * The BIOS leaves most of the hardware idle at that point, so unlike a savestate
+ * the snapshot only holds memory, register values and the time at which it was taken.
+ */
+struct BootSnapshot {
+  static constexpr std::uint32_t kMagic = 0x544F4F42; // "BOOT"
+  static constexpr std::uint32_t kVersion = 1;
+
+  std::uint32_t magic = kMagic;
+  std::uint32_t version = kVersion;
+  std::uint32_t size = sizeof(BootSnapshot);
+
+  // Hashes of the BIOS and the ROM that the snapshot was taken with.
+  std::uint64_t bios_hash = 0;
+  std::uint64_t rom_hash = 0;
+
+  std::uint64_t timestamp;
+
+  struct {
+    arm::RegisterFile regs;
+    arm::ARM7TDMI::Pipeline pipe;
+  } arm;
+
+  struct {
+    std::uint32_t bios_latch;
+    std::uint16_t waitcnt;
+    std::uint16_t keycnt;
+    std::uint8_t postflg;
+    std::uint8_t wram[0x40000];
+    std::uint8_t iram[0x08000];
+  } bus;
+
+  struct {
+    int ime;
+    std::uint16_t ie;
+    std::uint16_t if_;
+  } irq;
+
+  struct {
+    struct {
+      std::uint32_t src_addr;
+      std::uint32_t dst_addr;
+      std::uint16_t length;
+      std::uint16_t control;
+      struct {
+        std::uint32_t length;
+        std::uint32_t dst_addr;
+        std::uint32_t src_addr;
+        std::uint32_t bus;
+      } latch;
+    } channels[4];
+    std::uint32_t latch;
+  } dma;
+
+  struct {
+    std::uint16_t reload;
+    std::uint16_t counter;
+    std::uint8_t control;
+  } timer[4];
+
+  struct {
+    std::uint8_t soundcnt[4];
+    std::uint8_t soundbias[2];
+    std::uint8_t wave_ram[16];
+  } apu;
+
+  struct {
+    std::uint8_t pram[0x00400];
+    std::uint8_t oam [0x00400];
+    std::uint8_t vram[0x18000];
+    PPU::MMIO mmio;
+  } ppu;
+
+  struct {
+    std::uint32_t data32;
+    std::uint16_t siocnt;
+    std::uint16_t rcnt;
+    std::uint8_t data8;
+  } serial;
+};
+
+static_assert(std::is_trivially_copyable<BootSnapshot>::value, "BootSnapshot must be trivially copyable.");
+
+} // namespace nba::core
@@ -109,15 +109,13 @@ auto CPU::Read_(std::uint32_t address, Access access) -> T {
     }
     case REGION_MMIO: {
       PrefetchStepRAM(cycles);
+      NBA_STATS_ADD(stats.mmio_reads[(address & 0x3FF) >> 1], 1);
       if constexpr (std::is_same_v<T, std::uint32_t>) {
-        return (ReadMMIO(address + 0) <<  0) |
-               (ReadMMIO(address + 1) <<  8) |
-               (ReadMMIO(address + 2) << 16) |
-               (ReadMMIO(address + 3) << 24);
+        return (ReadMMIO16(address + 0) <<  0) |
+               (std::uint32_t(ReadMMIO16(address + 2)) << 16);
       }
       if constexpr (std::is_same_v<T, std::uint16_t>) {
-        return (ReadMMIO(address + 0) << 0) |
-               (ReadMMIO(address + 1) << 8);
+        return ReadMMIO16(address);
       }
       return ReadMMIO(address);
     }
@@ -228,15 +226,13 @@ void CPU::Write_(std::uint32_t address, T value, Access access) {
     }
     case REGION_MMIO: {
       PrefetchStepRAM(cycles);
+      NBA_STATS_ADD(stats.mmio_writes[(address & 0x3FF) >> 1], 1);
       if constexpr (std::is_same_v<T, std::uint32_t>) {
-        WriteMMIO(address + 0, (value >>  0) & 0xFF);
-        WriteMMIO(address + 1, (value >>  8) & 0xFF);
-        WriteMMIO(address + 2, (value >> 16) & 0xFF);
-        WriteMMIO(address + 3, (value >> 24) & 0xFF);
+        WriteMMIO16(address + 0, (value >>  0) & 0xFFFF);
+        WriteMMIO16(address + 2, (value >> 16) & 0xFFFF);
       }
       if constexpr (std::is_same_v<T, std::uint16_t>) {
-        WriteMMIO(address + 0, (value >> 0) & 0xFF);
-        WriteMMIO(address + 1, (value >> 8) & 0xFF);
+        WriteMMIO16(address, value);
       }
       if constexpr (std::is_same_v<T, std::uint8_t>) {
         WriteMMIO(address, value & 0xFF);
@@ -246,9 +242,9 @@ void CPU::Write_(std::uint32_t address, T value, Access access) {
     case REGION_PRAM: {
       PrefetchStepRAM(cycles);
       if constexpr (std::is_same_v<T, std::uint8_t>) {
-        Write<std::uint16_t>(ppu.pram, address & 0x3FE, value * 0x0101);
+        ppu.WritePRAM<std::uint16_t>(address & 0x3FE, value * 0x0101);
       } else {
-        Write<T>(ppu.pram, address & 0x3FF, value);
+        ppu.WritePRAM<T>(address & 0x3FF, value);
       }
       break;
     }
@@ -263,17 +259,17 @@ void CPU::Write_(std::uint32_t address, T value, Access access) {
         auto limit = ppu.mmio.dispcnt.mode >= 3 ? 0x14000 : 0x10000;
 
         if (address < limit) {
-          Write<std::uint16_t>(ppu.vram, address & ~1, value * 0x0101);
+          ppu.WriteVRAM<std::uint16_t>(address & ~1, value * 0x0101);
         }
       } else {
-        Write<T>(ppu.vram, address, value);
+        ppu.WriteVRAM<T>(address, value);
       }
       break;
     }
     case REGION_OAM: {
       PrefetchStepRAM(cycles);
       if constexpr (!std::is_same_v<T, std::uint8_t>) {
-        Write<T>(ppu.oam, address & 0x3FF, value);
+        ppu.WriteOAM<T>(address & 0x3FF, value);
       }
       break;
     }
@@ -15,6 +15,11 @@ auto CPU::ReadMMIO(std::uint32_t address) -> std::uint8_t {
   auto& apu_io = apu.mmio;
   auto& ppu_io = ppu.mmio;
 
+  // Audio is synthesized lazily, bring the sound state up to date.
+  if (address >= SOUND1CNT_L && address < FIFO_A) {
+    apu.Sync();
+  }
+
   switch (address) {
     /* PPU */
     case DISPCNT+0:  return ppu_io.dispcnt.Read(0);
@@ -225,6 +230,15 @@ void CPU::WriteMMIO(std::uint32_t address, std::uint8_t value) {
   auto& apu_io = apu.mmio;
   auto& ppu_io = ppu.mmio;
 
+  if (address <= BLDY + 1) {
+    ppu.OnRegisterWrite(address, value);
+  }
+
+  // Audio is synthesized lazily, it must catch up before the sound state changes.
+  if (address >= SOUND1CNT_L && address < FIFO_A) {
+    apu.Sync();
+  }
+
   switch (address) {
     /* PPU */
     case DISPCNT+0:  ppu_io.dispcnt.Write(0, value); break;
@@ -458,8 +472,16 @@ void CPU::WriteMMIO(std::uint32_t address, std::uint8_t value) {
     case SOUNDCNT_L:   apu_io.soundcnt.Write(0, value); break;
     case SOUNDCNT_L+1: apu_io.soundcnt.Write(1, value); break;
     case SOUNDCNT_H:   apu_io.soundcnt.Write(2, value); break;
-    case SOUNDCNT_H+1: apu_io.soundcnt.Write(3, value); break;
-    case SOUNDCNT_X:   apu_io.soundcnt.Write(4, value); break;
+    case SOUNDCNT_H+1:
+    case SOUNDCNT_X: {
+      // Changes which timers feed the FIFOs.
+      timer.Reschedule(0);
+      timer.Reschedule(1);
+      apu_io.soundcnt.Write(address == SOUNDCNT_X ? 4 : 3, value);
+      timer.Reschedule(0);
+      timer.Reschedule(1);
+      break;
+    }
     case SOUNDBIAS:    apu_io.bias.Write(0, value); break;
     case SOUNDBIAS+1:  apu_io.bias.Write(1, value); break;
 
@@ -569,4 +591,129 @@ void CPU::WriteMMIO(std::uint32_t address, std::uint8_t value) {
   }
 }
 
+auto CPU::ReadMMIO16(std::uint32_t address) -> std::uint16_t {
+  if (address >= 0x04000400) {
+    return ReadMMIO(address + 0) | (ReadMMIO(address + 1) << 8);
+  }
+  return mmio_table[(address & 0x3FF) >> 1].read(*this, address);
+}
+
+void CPU::WriteMMIO16(std::uint32_t address, std::uint16_t value) {
+  if (address >= 0x04000400) {
+    WriteMMIO(address + 0, value & 0xFF);
+    WriteMMIO(address + 1, value >> 8);
+    return;
+  }
+  mmio_table[(address & 0x3FF) >> 1].write(*this, address, value);
+}
+
+void CPU::InitMMIOTable() {
+  auto& table = mmio_table;
+
+  auto entry = [&](std::uint32_t address) -> MMIORegister& {
+    return table[(address & 0x3FF) >> 1];
+  };
+
+  // By default a halfword access is performed as two byte accesses.
+  for (auto& reg : table) {
+    reg.read = [](CPU& cpu, std::uint32_t address) -> std::uint16_t {
+      return cpu.ReadMMIO(address + 0) | (cpu.ReadMMIO(address + 1) << 8);
+    };
+    reg.write = [](CPU& cpu, std::uint32_t address, std::uint16_t value) {
+      cpu.WriteMMIO(address + 0, value & 0xFF);
+      cpu.WriteMMIO(address + 1, value >> 8);
+    };
+  }
+
+  /* PPU */
+  entry(DISPSTAT).read = [](CPU& cpu, std::uint32_t address) -> std::uint16_t {
+    auto& dispstat = cpu.ppu.mmio.dispstat;
+    return dispstat.Read(0) | (dispstat.Read(1) << 8);
+  };
+  entry(VCOUNT).read = [](CPU& cpu, std::uint32_t address) -> std::uint16_t {
+    return cpu.ppu.mmio.vcount & 0xFF;
+  };
+
+  /* SOUND */
+  entry(SOUNDCNT_H).write = [](CPU& cpu, std::uint32_t address, std::uint16_t value) {
+    auto& soundcnt = cpu.apu.mmio.soundcnt;
+    cpu.apu.Sync();
+    // Changes which timers feed the FIFOs.
+    cpu.timer.Reschedule(0);
+    cpu.timer.Reschedule(1);
+    soundcnt.Write(2, value & 0xFF);
+    soundcnt.Write(3, value >> 8);
+    cpu.timer.Reschedule(0);
+    cpu.timer.Reschedule(1);
+  };
+  for (auto address : { FIFO_A, FIFO_A + 2, FIFO_B, FIFO_B + 2 }) {
+    entry(address).write = [](CPU& cpu, std::uint32_t address, std::uint16_t value) {
+      auto& fifo = cpu.apu.mmio.fifo[(address >> 2) & 1];
+      fifo.Write(value & 0xFF);
+      fifo.Write(value >> 8);
+    };
+  }
+
+  /* DMAs 0-3 */
+  for (std::uint32_t address = DMA0SAD; address < DMA3CNT_H + 2; address += 2) {
+    entry(address).write = [](CPU& cpu, std::uint32_t address, std::uint16_t value) {
+      cpu.dma.WriteHalf((address - DMA0SAD) / 12, (address - DMA0SAD) % 12, value);
+    };
+  }
+
+  /* Timers 0-3 */
+  for (std::uint32_t address = TM0CNT_L; address < TM3CNT_H + 2; address += 2) {
+    entry(address).read = [](CPU& cpu, std::uint32_t address) -> std::uint16_t {
+      return cpu.timer.ReadHalf((address >> 2) & 3, address & 2);
+    };
+    entry(address).write = [](CPU& cpu, std::uint32_t address, std::uint16_t value) {
+      cpu.timer.WriteHalf((address >> 2) & 3, address & 2, value);
+    };
+  }
+
+  /* Keypad */
+  entry(KEYINPUT).read = [](CPU& cpu, std::uint32_t address) -> std::uint16_t {
+    return cpu.mmio.keyinput;
+  };
+  entry(KEYCNT).write = [](CPU& cpu, std::uint32_t address, std::uint16_t value) {
+    auto& keycnt = cpu.mmio.keycnt;
+    keycnt.input_mask = value & 0x3FF;
+    keycnt.interrupt = value & 0x4000;
+    keycnt.and_mode = value & 0x8000;
+    cpu.CheckKeypadInterrupt();
+  };
+
+  /* Interrupt Control */
+  for (auto address : { IE, IF }) {
+    entry(address).read = [](CPU& cpu, std::uint32_t address) -> std::uint16_t {
+      return cpu.irq.ReadHalf(address - IE);
+    };
+    entry(address).write = [](CPU& cpu, std::uint32_t address, std::uint16_t value) {
+      cpu.irq.WriteHalf(address - IE, value);
+    };
+  }
+  entry(IME).read = [](CPU& cpu, std::uint32_t address) -> std::uint16_t {
+    return cpu.irq.ReadHalf(4);
+  };
+  entry(IME).write = [](CPU& cpu, std::uint32_t address, std::uint16_t value) {
+    cpu.irq.WriteHalf(4, value);
+  };
+
+  /* Waitstates */
+  entry(WAITCNT).write = [](CPU& cpu, std::uint32_t address, std::uint16_t value) {
+    auto& waitcnt = cpu.mmio.waitcnt;
+    waitcnt.sram  = (value >>  0) & 3;
+    waitcnt.ws0_n = (value >>  2) & 3;
+    waitcnt.ws0_s = (value >>  4) & 1;
+    waitcnt.ws1_n = (value >>  5) & 3;
+    waitcnt.ws1_s = (value >>  7) & 1;
+    waitcnt.ws2_n = (value >>  8) & 3;
+    waitcnt.ws2_s = (value >> 10) & 1;
+    waitcnt.phi = (value >> 11) & 3;
+    waitcnt.prefetch = (value >> 14) & 1;
+    waitcnt.cgb = (value >> 15) & 1;
+    cpu.UpdateMemoryDelayTable();
+  };
+}
+
 } // namespace nba::core
@@ -6,8 +6,11 @@
  */
 
 #include "cpu.hpp"
+#include "cpu-mmio.hpp"
 
+#include <algorithm>
 #include <common/likely.hpp>
+#include <cstdlib>
 #include <cstring>
 
 namespace nba::core {
@@ -22,19 +25,34 @@ using Key = InputDevice::Key;
 CPU::CPU(std::shared_ptr<Config> config)
     : ARM7TDMI::ARM7TDMI(scheduler, this)
     , config(config)
+    , scheduler(stats)
     , irq(*this, scheduler)
-    , dma(*this, irq, scheduler)
+    , dma(*this, irq, scheduler, stats)
     , apu(scheduler, dma, config)
-    , ppu(scheduler, irq, dma, config)
+    , ppu(scheduler, irq, dma, stats, config)
     , timer(scheduler, irq, apu)
     , serial_bus(irq) {
   std::memset(memory.bios, 0, 0x04000);
   memory.rom.size = 0;
   memory.rom.mask = 0;
+  dma.SetBulkTransfer([this](std::uint32_t src_addr, std::uint32_t dst_addr, int src_modify,
+                             int dst_modify, int count, bool word, std::uint32_t& bus) {
+    return DMABulkTransfer(src_addr, dst_addr, src_modify, dst_modify, count, word, bus);
+  });
+  InitMMIOTable();
   Reset();
 }
 
 void CPU::Reset() {
+  ResetState(false);
+  config->input_dev->SetOnChangeCallback(std::bind(&CPU::OnKeyPress,this));
+}
+
+void CPU::SoftReset() {
+  ResetState(true);
+}
+
+void CPU::ResetState(bool soft) {
   std::memset(memory.wram, 0, 0x40000);
   std::memset(memory.iram, 0, 0x08000);
 
@@ -55,8 +73,13 @@ void CPU::Reset() {
   irq.Reset();
   dma.Reset();
   timer.Reset();
-  apu.Reset();
-  ppu.Reset();
+  if (soft) {
+    apu.SoftReset();
+    ppu.SoftReset();
+  } else {
+    apu.Reset();
+    ppu.Reset();
+  }
   serial_bus.Reset();
   ARM7TDMI::Reset();
 
@@ -70,11 +93,97 @@ void CPU::Reset() {
 
   m4a_soundinfo = nullptr;
   m4a_original_freq = 0;
-  if (config->audio.m4a_xq_enable && memory.rom.data != nullptr) {
+  boot_snapshot_callback = nullptr;
+
+  InputEvent event;
+  input_event_pending = false;
+  while (input_queue.Read(&event, 1) != 0) { }
+
+  // The ROM stays the same, so do the locations of the M4A routines.
+  if (soft) {
+    return;
+  }
+
+  if (config->audio.m4a_xq_enable && memory.rom.scan) {
     M4ASearchForSampleFreqSet();
   }
 
-  config->input_dev->SetOnChangeCallback(std::bind(&CPU::OnKeyPress,this));
+  m4a_soundmain_ram_address = 0;
+  if (config->audio.m4a_hle_enable && memory.rom.scan) {
+    M4ASearchForSoundMain();
+  }
+}
+
+void CPU::RequestBootSnapshot(std::function<void(BootSnapshot const&)> callback) {
+  boot_snapshot_callback = callback;
+}
+
+void CPU::TakeBootSnapshot() {
+  auto callback = std::move(boot_snapshot_callback);
+  auto& apu_io = apu.mmio;
+
+  boot_snapshot_callback = nullptr;
+
+  /* The PPU and the APU frame sequencer always have an event pending,
+   * any other event belongs to hardware that is still active (e.g. a timer, DMA or an IRQ that is being raised).
+   */
+  bool idle = scheduler.GetEventCount() == 2 &&
+              !dma.IsRunning() &&
+              !prefetch.active && prefetch.count == 0 &&
+              !apu_io.soundcnt.master_enable &&
+              !apu_io.psg1.IsEnabled() && !apu_io.psg2.IsEnabled() &&
+              !apu_io.psg3.IsEnabled() && !apu_io.psg4.IsEnabled() &&
+              apu_io.fifo[0].Count() == 0 && apu_io.fifo[1].Count() == 0;
+
+  if (!idle) {
+    LOG_WARN("Unable to take a boot snapshot, the BIOS left some hardware active.");
+    return;
+  }
+
+  auto snapshot = std::make_unique<BootSnapshot>();
+
+  snapshot->timestamp = scheduler.GetTimestampNow();
+  snapshot->arm.regs = state;
+  snapshot->arm.pipe = GetPipeline();
+
+  snapshot->bus.bios_latch = memory.bios_latch;
+  snapshot->bus.waitcnt = ReadMMIO16(WAITCNT);
+  snapshot->bus.keycnt = ReadMMIO16(KEYCNT);
+  snapshot->bus.postflg = mmio.postflg;
+  std::memcpy(snapshot->bus.wram, memory.wram, sizeof(memory.wram));
+  std::memcpy(snapshot->bus.iram, memory.iram, sizeof(memory.iram));
+
+  irq.CopyState(*snapshot);
+  dma.CopyState(*snapshot);
+  timer.CopyState(*snapshot);
+  apu.CopyState(*snapshot);
+  ppu.CopyState(*snapshot);
+  serial_bus.CopyState(*snapshot);
+
+  callback(*snapshot);
+}
+
+void CPU::LoadBootSnapshot(BootSnapshot const& snapshot) {
+  // The PPU and the APU reschedule their events relative to the time of the snapshot.
+  scheduler.Reset(snapshot.timestamp);
+
+  state = snapshot.arm.regs;
+  SwitchMode(state.cpsr.f.mode);
+  SetPipeline(snapshot.arm.pipe);
+
+  memory.bios_latch = snapshot.bus.bios_latch;
+  WriteMMIO16(WAITCNT, snapshot.bus.waitcnt);
+  WriteMMIO16(KEYCNT, snapshot.bus.keycnt);
+  mmio.postflg = snapshot.bus.postflg;
+  std::memcpy(memory.wram, snapshot.bus.wram, sizeof(memory.wram));
+  std::memcpy(memory.iram, snapshot.bus.iram, sizeof(memory.iram));
+
+  irq.LoadState(snapshot);
+  dma.LoadState(snapshot);
+  timer.LoadState(snapshot);
+  apu.LoadState(snapshot);
+  ppu.LoadState(snapshot);
+  serial_bus.LoadState(snapshot);
 }
 
 void CPU::Tick(int cycles) {
@@ -156,6 +265,7 @@ void CPU::PrefetchStepROM(std::uint32_t address, int cycles) {
   if (prefetch.active) {
     if (code && address == prefetch.last_address) {
       // Complete the load and consume the fetched (half)word right away.
+      NBA_STATS_ADD(stats.prefetch_hits, 1);
       Tick(prefetch.countdown);
       prefetch.count--;
       return;
@@ -166,6 +276,7 @@ void CPU::PrefetchStepROM(std::uint32_t address, int cycles) {
 
   if (code && prefetch.count != 0) {
     if (address == prefetch.head_address) {
+      NBA_STATS_ADD(stats.prefetch_hits, 1);
       prefetch.count--;
       prefetch.head_address += prefetch.opcode_width;
       PrefetchStepRAM(1);
@@ -175,11 +286,220 @@ void CPU::PrefetchStepROM(std::uint32_t address, int cycles) {
     }
   }
 
+  if (code) {
+    NBA_STATS_ADD(stats.prefetch_misses, 1);
+  }
+
   Tick(cycles);
 }
 
+/* Returns a host pointer to [address, address + size) if the range lies in a single
+ * memory area which DMA may access in bulk, without crossing a mirror boundary.
+ */
+auto CPU::GetDMAHostPointer(std::uint32_t address, std::uint32_t size, bool write) -> std::uint8_t* {
+  std::uint32_t offset;
+
+  switch (address >> 24) {
+    case REGION_EWRAM:
+      offset = address & 0x3FFFF;
+      if (offset + size <= 0x40000) {
+        return memory.wram + offset;
+      }
+      break;
+    case REGION_IWRAM:
+      offset = address & 0x7FFF;
+      if (offset + size <= 0x8000) {
+        return memory.iram + offset;
+      }
+      break;
+    case REGION_PRAM:
+      offset = address & 0x3FF;
+      if (offset + size <= 0x400) {
+        return ppu.pram + offset;
+      }
+      break;
+    case REGION_OAM:
+      offset = address & 0x3FF;
+      if (offset + size <= 0x400) {
+        return ppu.oam + offset;
+      }
+      break;
+    case REGION_VRAM:
+      offset = address & 0x1FFFF;
+      if (offset < 0x18000) {
+        if (offset + size <= 0x18000) {
+          return ppu.vram + offset;
+        }
+      } else if (offset + size <= 0x20000) {
+        return ppu.vram + (offset & ~0x8000);
+      }
+      break;
+    case REGION_ROM_W2_H:
+      if (memory.rom.backup_eeprom) {
+        break;
+      }
+      [[fallthrough]];
+    case REGION_ROM_W0_L:
+    case REGION_ROM_W0_H:
+    case REGION_ROM_W1_L:
+    case REGION_ROM_W1_H:
+    case REGION_ROM_W2_L: {
+      if (write) {
+        break;
+      }
+      offset = address & memory.rom.mask;
+      if (offset + size > memory.rom.size || ((address + size - 1) & memory.rom.mask) != offset + size - 1) {
+        break;
+      }
+      if (memory.rom.gpio && offset < 0xCA && offset + size > 0xC4) {
+        break;
+      }
+      return memory.rom.data.get() + offset;
+    }
+  }
+
+  return nullptr;
+}
+
+/* Counts the accesses to address + i * modify (0 <= i < count) which are forced to be
+ * non-sequential because they start a new 128 KiB block.
+ */
+static auto CountBlockBoundaries(std::uint32_t address, int modify, int count) -> int {
+  if (modify == 0) {
+    return (address & 0x1FFFF) == 0 ? count : 0;
+  }
+
+  int distance = modify > 0 ? ((0x20000 - (address & 0x1FFFF)) & 0x1FFFF) : (address & 0x1FFFF);
+  int first = distance / std::abs(modify);
+
+  if (first >= count) {
+    return 0;
+  }
+  return 1 + (count - 1 - first) / (0x20000 / std::abs(modify));
+}
+
+auto CPU::DMABulkTransfer(std::uint32_t src_addr, std::uint32_t dst_addr, int src_modify,
+                          int dst_modify, int count, bool word, std::uint32_t& bus) -> int {
+  int src_page = src_addr >> 24;
+  int dst_page = dst_addr >> 24;
+  int unit = word ? 4 : 2;
+
+  // Sequential code fetches from ROM interact with the prefetch buffer on every DMA access.
+  if (mmio.waitcnt.prefetch && code && src_page >= REGION_ROM_W0_L) {
+    return -1;
+  }
+
+  auto lowest = [&](std::uint32_t address, int modify, int count) -> std::uint32_t {
+    return modify < 0 ? address + modify * (count - 1) : address;
+  };
+
+  auto size = [&](int modify, int count) -> std::uint32_t {
+    return modify == 0 ? unit : count * unit;
+  };
+
+  if (GetDMAHostPointer(lowest(src_addr, src_modify, count), size(src_modify, count), false) == nullptr ||
+      GetDMAHostPointer(lowest(dst_addr, dst_modify, count), size(dst_modify, count), true) == nullptr) {
+    return -1;
+  }
+
+  auto& table = word ? cycles32 : cycles16;
+  int src_n = table[int(Access::Nonsequential)][src_page];
+  int src_s = table[int(Access::Sequential)][src_page];
+  int dst_n = table[int(Access::Nonsequential)][dst_page];
+  int dst_s = table[int(Access::Sequential)][dst_page];
+
+  auto cycles = [&](int count) -> int {
+    return count * (src_s + dst_s) +
+      CountBlockBoundaries(src_addr, src_modify, count) * (src_n - src_s) +
+      CountBlockBoundaries(dst_addr, dst_modify, count) * (dst_n - dst_s);
+  };
+
+  // Transfer as many units as possible without crossing the next scheduler event.
+  int limit = scheduler.GetRemainingCycleCount() - 1;
+  int units = std::min(count, limit / (src_s + dst_s));
+
+  while (units > 0 && cycles(units) > limit) {
+    units--;
+  }
+
+  if (units <= 0) {
+    return 0;
+  }
+
+  auto src = GetDMAHostPointer(src_addr, unit, false);
+  auto last = src + std::ptrdiff_t(units - 1) * src_modify;
+
+  if (word) {
+    DMABulkCopy<std::uint32_t>(src, dst_addr, src_modify, dst_modify, units);
+    bus = Read<std::uint32_t>(last, 0);
+  } else {
+    DMABulkCopy<std::uint16_t>(src, dst_addr, src_modify, dst_modify, units);
+    bus = Read<std::uint16_t>(last, 0) * 0x00010001;
+  }
+
+  scheduler.AddCycles(cycles(units));
+  return units;
+}
+
+template<typename T>
+void CPU::DMABulkCopy(std::uint8_t const* src, std::uint32_t dst_addr, int src_modify, int dst_modify, int count) {
+  auto dst = GetDMAHostPointer(dst_addr, sizeof(T), true);
+  auto size = count * sizeof(T);
+
+  auto read = [&](int i) -> T {
+    T value;
+    std::memcpy(&value, src + std::ptrdiff_t(i) * src_modify, sizeof(T));
+    return value;
+  };
+
+  bool block = src_modify == sizeof(T) && dst_modify == sizeof(T) && (src + size <= dst || dst + size <= src);
+
+  switch (dst_addr >> 24) {
+    case REGION_PRAM:
+      if (block) {
+        ppu.WritePRAMBlock<T>(dst - ppu.pram, src, count);
+      } else {
+        for (int i = 0; i < count; i++) {
+          ppu.WritePRAM<T>(dst - ppu.pram + i * dst_modify, read(i));
+        }
+      }
+      break;
+    case REGION_OAM:
+      if (block) {
+        ppu.WriteOAMBlock<T>(dst - ppu.oam, src, count);
+      } else {
+        for (int i = 0; i < count; i++) {
+          ppu.WriteOAM<T>(dst - ppu.oam + i * dst_modify, read(i));
+        }
+      }
+      break;
+    case REGION_VRAM:
+      if (block) {
+        ppu.WriteVRAMBlock<T>(dst - ppu.vram, src, count);
+      } else {
+        for (int i = 0; i < count; i++) {
+          ppu.WriteVRAM<T>(dst - ppu.vram + i * dst_modify, read(i));
+        }
+      }
+      break;
+    default:
+      if (block) {
+        std::memcpy(dst, src, size);
+      } else {
+        for (int i = 0; i < count; i++) {
+          auto value = read(i);
+          std::memcpy(dst + std::ptrdiff_t(i) * dst_modify, &value, sizeof(T));
+        }
+      }
+      break;
+  }
+}
+
 void CPU::RunFor(int cycles) {
   bool m4a_xq_enable = config->audio.m4a_xq_enable && m4a_setfreq_address != 0;
+  bool m4a_hle_enable = config->audio.m4a_hle_enable && m4a_soundmain_ram_address != 0;
+  bool boot_snapshot_pending = bool(boot_snapshot_callback);
+  DrainInputQueue();
   if (m4a_xq_enable && m4a_soundinfo != nullptr) {
     M4AFixupPercussiveChannels();
   }
@@ -195,11 +515,23 @@ void CPU::RunFor(int cycles) {
       if (unlikely(m4a_xq_enable && state.r15 == m4a_setfreq_address)) {
         M4ASampleFreqSetHook();
       }
+      if (unlikely(m4a_hle_enable && state.r15 == m4a_soundmain_ram_address)) {
+        M4ASoundMainRAMHook();
+      }
+      // The BIOS has finished once it jumps to the game.
+      if (unlikely(boot_snapshot_pending && (state.r15 >> 24) >= REGION_ROM_W0_L)) {
+        TakeBootSnapshot();
+        boot_snapshot_pending = false;
+      }
+      NBA_STATS_ADD(stats.instructions[state.cpsr.f.thumb], 1);
       Run();
     } else {
+      NBA_STATS_ADD(stats.cycles_halted, scheduler.GetRemainingCycleCount());
       Tick(scheduler.GetRemainingCycleCount());
     }
   }
+
+  apu.Sync();
 }
 
 void CPU::UpdateMemoryDelayTable() {
@@ -239,25 +571,11 @@ void CPU::UpdateMemoryDelayTable() {
 }
 
 void CPU::M4ASearchForSampleFreqSet() {
-  static const std::uint8_t pattern[] = {
-    0x53, 0x6D, 0x73, 0x68, 0x70, 0xB5, 0x02, 0x1C,
-    0x1E, 0x48, 0x04, 0x68, 0xF0, 0x20, 0x00, 0x03,
-    0x10, 0x40, 0x02, 0x0C
-  };
-  for (std::uint32_t i = 0; i < memory.rom.size; i++) {
-    bool match = true;
-    for (int j = 0; j < sizeof(pattern); j++) {
-      if (memory.rom.data[i + j] != pattern[j]) {
-        match = false;
-        i += j;
-        break;
-      }
-    }
-    if (match) {
-      m4a_setfreq_address = i + 0x08000008;
-      LOG_INFO("Found M4A SetSampleFreq() routine at 0x{0:08X}.", m4a_setfreq_address);
-      return;
-    }
+  auto const& matches = memory.rom.scan->m4a_sample_freq_set;
+
+  if (!matches.empty()) {
+    m4a_setfreq_address = matches[0] + 0x08000008;
+    LOG_INFO("Found M4A SetSampleFreq() routine at 0x{0:08X}.", m4a_setfreq_address);
   }
 }
 
@@ -315,6 +633,116 @@ void CPU::M4AFixupPercussiveChannels() {
   }
 }
 
+void CPU::M4ASearchForSoundMain() {
+  auto rom = memory.rom.data.get();
+  std::uint32_t size = memory.rom.size;
+
+  for (std::uint32_t i : memory.rom.scan->m4a_sound_main) {
+    if (i < 2) {
+      continue;
+    }
+
+    LOG_INFO("Found M4A SoundMain() routine at 0x{0:08X}.", i - 2 + 0x08000000);
+
+    /* SoundMain() ends with a jump to the mixer (SoundMainRAM), which has been copied to RAM:
+     *   ldr r3, =SoundMainRAM
+     *   bx r3
+     */
+    auto end = std::min(i + 0x100, size - 2);
+    for (std::uint32_t j = i; j < end; j += 2) {
+      auto opcode = Read<std::uint16_t>(rom, j);
+      if ((opcode & 0xFF00) == 0x4B00 && Read<std::uint16_t>(rom, j + 2) == 0x4718) {
+        auto literal = ((j + 4) & ~3) + (opcode & 0xFF) * 4;
+        if (literal + 4 > size) {
+          break;
+        }
+        auto address = Read<std::uint32_t>(rom, literal);
+        // The hook is checked against r15, which is two instructions ahead.
+        if (address & 1) {
+          m4a_soundmain_ram_address = (address & ~1) + 4;
+        } else {
+          m4a_soundmain_ram_address = (address & ~3) + 8;
+        }
+        LOG_INFO("Found M4A SoundMainRAM() routine at 0x{0:08X}.", address & ~1);
+        return;
+      }
+    }
+  }
+}
+
+void CPU::M4ASoundMainRAMHook() {
+  /* The mixer is entered with the stack frame of SoundMain() in place:
+   *   sp + 0x00: locals (0x18 bytes)
+   *   sp + 0x18: SoundInfo pointer
+   *   sp + 0x1C: r8 - r11
+   *   sp + 0x2C: r4 - r7
+   *   sp + 0x3C: return address
+   */
+  auto stack = M4AGetHostPointer(state.r13, 0x40);
+
+  if (stack == nullptr) {
+    return;
+  }
+
+  auto sound_info = reinterpret_cast<M4ASoundInfo*>(M4AGetHostPointer(Read<std::uint32_t>(stack, 0x18), sizeof(M4ASoundInfo)));
+
+  // Leave it to the game's mixer unless SoundMain() has locked the SoundInfo.
+  if (sound_info == nullptr || sound_info->magic != kM4ASoundInfoMagic + 1) {
+    return;
+  }
+
+  apu.Sync();
+
+  auto handled = apu.mp2k.SoundMainRAM(*sound_info, [this](std::uint32_t address, std::uint32_t size) {
+    return M4AGetHostPointer(address, size);
+  }, scheduler.GetTimestampNow());
+
+  if (!handled) {
+    return;
+  }
+
+  sound_info->magic = kM4ASoundInfoMagic;
+
+  // Return from SoundMain() like the mixer's epilogue does.
+  for (int i = 0; i < 4; i++) {
+    state.reg[i] = Read<std::uint32_t>(stack, 0x1C + i * 4);
+    state.reg[8 + i] = state.reg[i];
+    state.reg[4 + i] = Read<std::uint32_t>(stack, 0x2C + i * 4);
+  }
+  state.r3 = Read<std::uint32_t>(stack, 0x3C);
+  state.r13 += 0x40;
+  BranchExchange(state.r3);
+}
+
+auto CPU::M4AGetHostPointer(std::uint32_t address, std::uint32_t size) -> std::uint8_t* {
+  std::uint64_t offset = address & 0x00FFFFFF;
+
+  switch (address >> 24) {
+    case REGION_EWRAM:
+      if (offset + size <= sizeof(memory.wram)) {
+        return memory.wram + offset;
+      }
+      break;
+    case REGION_IWRAM:
+      if (offset + size <= sizeof(memory.iram)) {
+        return memory.iram + offset;
+      }
+      break;
+    case REGION_ROM_W0_L:
+    case REGION_ROM_W0_H:
+    case REGION_ROM_W1_L:
+    case REGION_ROM_W1_H:
+    case REGION_ROM_W2_L:
+    case REGION_ROM_W2_H:
+      offset = address & 0x01FFFFFF;
+      if (offset + size <= memory.rom.size) {
+        return memory.rom.data.get() + offset;
+      }
+      break;
+  }
+
+  return nullptr;
+}
 
 void CPU::OnKeyPress() {
   auto &keyinput = mmio.keyinput;
@@ -333,6 +761,41 @@ void CPU::OnKeyPress() {
   CheckKeypadInterrupt();
 }
 
+void CPU::SetKeys(std::uint16_t mask, int delay) {
+  if (delay > 0) {
+    scheduler.Add(delay, EventClass::Input, [this, mask](int cycles_late) {
+      SetKeys(mask);
+    });
+    return;
+  }
+  mmio.keyinput = ~mask & 0x3FF;
+  CheckKeypadInterrupt();
+}
+
+void CPU::QueueKeys(std::uint16_t mask, std::uint64_t timestamp) {
+  input_queue.Write({ timestamp, mask });
+  input_queue.Flush();
+}
+
+void CPU::DrainInputQueue() {
+  auto now = scheduler.GetTimestampNow();
+  InputEvent event;
+
+  while (!input_event_pending && input_queue.Available() != 0) {
+    event = input_queue.Peek(0);
+    if (event.timestamp > now) {
+      scheduler.Add(event.timestamp - now, EventClass::Input, [this](int cycles_late) {
+        input_event_pending = false;
+        DrainInputQueue();
+      });
+      input_event_pending = true;
+      break;
+    }
+    input_queue.Read(&event, 1);
+    SetKeys(event.keys);
+  }
+}
+
 void CPU::CheckKeypadInterrupt() {
   const auto& keycnt = mmio.keycnt;
   const auto keyinput = ~mmio.keyinput & 0x3FF;
@@ -7,15 +7,19 @@
 
 #pragma once
 
+#include <common/dsp/spsc_ring_buffer.hpp>
 #include <common/log.hpp>
 #include <common/m4a.hpp>
 #include <emulator/cartridge/backup/backup.hpp>
 #include <emulator/cartridge/gpio/gpio.hpp>
+#include <emulator/cartridge/rom_scan.hpp>
 #include <emulator/config/config.hpp>
+#include <functional>
 #include <memory>
 #include <type_traits>
 
 #include "arm/arm7tdmi.hpp"
+#include "boot_snapshot.hpp"
 #include "hw/apu/apu.hpp"
 #include "hw/ppu/ppu.hpp"
 #include "hw/dma.hpp"
@@ -23,6 +27,7 @@
 #include "hw/serial.hpp"
 #include "hw/timer.hpp"
 #include "scheduler.hpp"
+#include "stats.hpp"
 
 namespace nba::core {
 
@@ -33,8 +38,34 @@ public:
   CPU(std::shared_ptr<Config> config);
 
   void Reset();
+
+  /* Resets the emulated hardware, but keeps the audio device, the render threads
+   * and all allocations around. Changes to the configuration require a full Reset().
+   */
+  void SoftReset();
+
   void RunFor(int cycles);
 
+  /* Takes a snapshot once the BIOS jumps to the game and passes it to the callback.
+   * No snapshot is taken if the BIOS leaves hardware active, which the snapshot cannot describe.
+   */
+  void RequestBootSnapshot(std::function<void(BootSnapshot const&)> callback);
+
+  // Continues from a boot snapshot instead of running the BIOS, must be called right after a reset.
+  void LoadBootSnapshot(BootSnapshot const& snapshot);
+
+  /* Sets the state of all keys at once, bypassing the input device.
+   * The bits are laid out like in KEYINPUT, except that a set bit means that the key is pressed.
+   * With a delay the keys change that many cycles into the next call to RunFor().
+   */
+  void SetKeys(std::uint16_t mask, int delay = 0);
+
+  /* Queues a key mask (see SetKeys()) for the given cycle since the reset. May be called from one other thread.
+   * The queue is drained whenever RunFor() starts, keys for a cycle in the past change right then.
+   * Input that is still queued on a reset is discarded.
+   */
+  void QueueKeys(std::uint16_t mask, std::uint64_t timestamp);
+
   enum MemoryRegion {
     REGION_BIOS  = 0,
     REGION_EWRAM = 2,
@@ -73,6 +104,7 @@ public:
       std::unique_ptr<nba::GPIO> gpio;
       std::unique_ptr<nba::Backup> backup_sram;
       std::unique_ptr<nba::Backup> backup_eeprom;
+      std::shared_ptr<nba::ROMScanResult const> scan;
     } rom;
 
     std::uint32_t bios_latch = 0;
@@ -105,6 +137,9 @@ public:
 
   } mmio;
 
+  // Profiling counters (see stats.hpp), these are only cleared by Emulator::ResetStats().
+  Stats stats;
+
   Scheduler scheduler;
   IRQ irq;
   DMA dma;
@@ -136,6 +171,9 @@ private:
 
   auto ReadMMIO (std::uint32_t address) -> std::uint8_t;
   void WriteMMIO(std::uint32_t address, std::uint8_t value);
+  auto ReadMMIO16 (std::uint32_t address) -> std::uint16_t;
+  void WriteMMIO16(std::uint32_t address, std::uint16_t value);
+  void InitMMIOTable();
   auto ReadBIOS(std::uint32_t address) -> std::uint32_t;
   auto ReadUnused(std::uint32_t address) -> std::uint32_t;
 
@@ -169,22 +207,48 @@ private:
     Write_<std::uint32_t>(address, value, access);
   }
 
+  void ResetState(bool soft);
   void Tick(int cycles);
   void Idle() final;
   void PrefetchStepRAM(int cycles);
   void PrefetchStepROM(std::uint32_t address, int cycles);
   void UpdateMemoryDelayTable();
 
+  auto GetDMAHostPointer(std::uint32_t address, std::uint32_t size, bool write) -> std::uint8_t*;
+  auto DMABulkTransfer(std::uint32_t src_addr, std::uint32_t dst_addr, int src_modify,
+                       int dst_modify, int count, bool word, std::uint32_t& bus) -> int;
+
+  template<typename T>
+  void DMABulkCopy(std::uint8_t const* src, std::uint32_t dst_addr, int src_modify, int dst_modify, int count);
+
   void M4ASearchForSampleFreqSet();
   void M4ASampleFreqSetHook();
   void M4AFixupPercussiveChannels();
+  void M4ASearchForSoundMain();
+  void M4ASoundMainRAMHook();
+  auto M4AGetHostPointer(std::uint32_t address, std::uint32_t size) -> std::uint8_t*;
 
   void CheckKeypadInterrupt();
   void OnKeyPress();
+  void DrainInputQueue();
+
+  void TakeBootSnapshot();
 
   M4ASoundInfo* m4a_soundinfo;
   int m4a_original_freq = 0;
   std::uint32_t m4a_setfreq_address = 0;
+  std::uint32_t m4a_soundmain_ram_address = 0;
+
+  std::function<void(BootSnapshot const&)> boot_snapshot_callback;
+
+  struct InputEvent {
+    std::uint64_t timestamp;
+    std::uint16_t keys;
+  };
+
+  // At most one queued input event is scheduled at a time, the others wait in the queue.
+  common::dsp::SPSCRingBuffer<InputEvent> input_queue {256};
+  bool input_event_pending = false;
 
   /* GamePak prefetch buffer state. */
   struct Prefetch {
@@ -199,6 +263,14 @@ private:
     int duty;
   } prefetch;
 
+  /* Handlers for each halfword of the I/O register space.
+   * Registers without a native handler fall back to the byte handlers.
+   */
+  struct MMIORegister {
+    std::uint16_t (*read)(CPU& cpu, std::uint32_t address);
+    void (*write)(CPU& cpu, std::uint32_t address, std::uint16_t value);
+  } mmio_table[0x200];
+
   bool bus_is_controlled_by_dma;
   bool openbus_from_dma;
 
@@ -11,6 +11,7 @@
 #include <common/dsp/resampler/cubic.hpp>
 #include <common/dsp/resampler/nearest.hpp>
 #include <common/dsp/resampler/windowed-sinc.hpp>
+#include <emulator/core/boot_snapshot.hpp>
 
 #include "apu.hpp"
 
@@ -29,26 +30,17 @@ APU::APU(Scheduler& scheduler, DMA& dma, std::shared_ptr<Config> config)
 void APU::Reset() {
   using namespace common::dsp;
 
-  mmio.fifo[0].Reset();
-  mmio.fifo[1].Reset();
-  mmio.psg1.Reset();
-  mmio.psg2.Reset();
-  mmio.psg3.Reset();
-  mmio.psg4.Reset();
-  mmio.soundcnt.Reset();
-  mmio.bias.Reset();
-
-  resolution_old = 0;
-  scheduler.Add(mmio.bias.GetSampleInterval(), this, &APU::StepMixer);
-  scheduler.Add(BaseChannel::s_cycles_per_step, this, &APU::StepSequencer);
+  ResetState();
 
+  // The audio callback will not be invoked once the device has been closed.
   auto audio_dev = config->audio_dev;
   audio_dev->Close();
+  buffer_ready = false;
   audio_dev->Open(this, (AudioDevice::Callback)AudioCallback);
 
   using Interpolation = Config::Audio::Interpolation;
 
-  buffer = std::make_shared<common::dsp::StereoRingBuffer<float>>(audio_dev->GetBlockSize() * 4, true);
+  buffer = std::make_shared<common::dsp::StereoSPSCRingBuffer<float>>(audio_dev->GetBlockSize() * 4);
 
   switch (config->audio.interpolation) {
     case Interpolation::Cosine:
@@ -80,7 +72,87 @@ void APU::Reset() {
     }
   }
 
-  resampler->SetSampleRates(mmio.bias.GetSampleRate(), audio_dev->GetSampleRate());
+  UpdateSampleRate();
+
+  buffer_ready.store(true, std::memory_order_release);
+}
+
+void APU::SoftReset() {
+  ResetState();
+
+  // Samples that were already queued for the audio device are still played back.
+  resampler->Reset();
+
+  if (config->audio.interpolate_fifo) {
+    for (int fifo = 0; fifo < 2; fifo++) {
+      fifo_buffer[fifo]->Reset();
+      fifo_resampler[fifo]->Reset();
+      fifo_samplerate[fifo] = 0;
+    }
+  }
+
+  UpdateSampleRate();
+}
+
+void APU::ResetState() {
+  mmio.fifo[0].Reset();
+  mmio.fifo[1].Reset();
+  mmio.psg1.Reset();
+  mmio.psg2.Reset();
+  mmio.psg3.Reset();
+  mmio.psg4.Reset();
+  mmio.soundcnt.Reset();
+  mmio.bias.Reset();
+
+  resolution_old = 0;
+  rate_adjust = 1;
+  mp2k.Reset();
+  mp2k.SetSampleRate(mmio.bias.GetSampleRate());
+  timestamp_next_sample = scheduler.GetTimestampNow() + mmio.bias.GetSampleInterval();
+  fifo_samples.clear();
+  scheduler.Add(BaseChannel::s_cycles_per_step, EventClass::APU, this, &APU::StepSequencer);
+}
+
+void APU::CopyState(BootSnapshot& snapshot) {
+  auto& state = snapshot.apu;
+
+  Sync();
+
+  for (int i = 0; i < 4; i++) {
+    state.soundcnt[i] = mmio.soundcnt.Read(i);
+  }
+
+  state.soundbias[0] = mmio.bias.Read(0);
+  state.soundbias[1] = mmio.bias.Read(1);
+
+  for (int i = 0; i < 16; i++) {
+    state.wave_ram[i] = mmio.psg3.ReadSample(i);
+  }
+}
+
+void APU::LoadState(BootSnapshot const& snapshot) {
+  auto const& state = snapshot.apu;
+  auto now = scheduler.GetTimestampNow();
+
+  for (int i = 0; i < 4; i++) {
+    mmio.soundcnt.Write(i, state.soundcnt[i]);
+  }
+
+  mmio.bias.Write(0, state.soundbias[0]);
+  mmio.bias.Write(1, state.soundbias[1]);
+
+  for (int i = 0; i < 16; i++) {
+    mmio.psg3.WriteSample(i, state.wave_ram[i]);
+  }
+
+  timestamp_next_sample = now + mmio.bias.GetSampleInterval();
+
+  // The frame sequencer steps in a fixed cycle since the reset.
+  scheduler.Add(BaseChannel::s_cycles_per_step - now % BaseChannel::s_cycles_per_step, EventClass::APU, this, &APU::StepSequencer);
+}
+
+void APU::Sync() {
+  Synthesize(scheduler.GetTimestampNow());
 }
 
 void APU::OnTimerOverflow(int timer_id, int times, int samplerate) {
@@ -98,15 +170,8 @@ void APU::OnTimerOverflow(int timer_id, int times, int samplerate) {
       for (int time = 0; time < times - 1; time++) {
         fifo.Read();
       }
-      if (config->audio.interpolate_fifo) {
-        if (samplerate != fifo_samplerate[fifo_id]) {
-          fifo_resampler[fifo_id]->SetSampleRates(samplerate, mmio.bias.GetSampleRate());
-          fifo_samplerate[fifo_id] = samplerate;
-        }
-        fifo_resampler[fifo_id]->Write(fifo.Read() / 128.0);
-      } else {
-        latch[fifo_id] = fifo.Read();
-      }
+      // The sample is handed to the mixer once the audio is synthesized.
+      fifo_samples.push_back({ scheduler.GetTimestampNow(), fifo_id, samplerate, fifo.Read() });
       if (fifo.Count() <= 16) {
         dma.Request(occasion[fifo_id]);
       }
@@ -114,12 +179,63 @@ void APU::OnTimerOverflow(int timer_id, int times, int samplerate) {
   }
 }
 
-void APU::StepMixer(int cycles_late) {
+void APU::Synthesize(std::uint64_t timestamp) {
+  auto fifo_sample = fifo_samples.begin();
+
+  while (timestamp_next_sample <= timestamp) {
+    while (fifo_sample != fifo_samples.end() && fifo_sample->timestamp <= timestamp_next_sample) {
+      LatchFIFOSample(*fifo_sample++);
+    }
+
+    mmio.psg1.Run(timestamp_next_sample);
+    mmio.psg2.Run(timestamp_next_sample);
+    mmio.psg3.Run(timestamp_next_sample);
+    mmio.psg4.Run(timestamp_next_sample);
+
+    MixSample();
+
+    timestamp_next_sample += mmio.bias.GetSampleInterval();
+  }
+
+  while (fifo_sample != fifo_samples.end()) {
+    LatchFIFOSample(*fifo_sample++);
+  }
+  fifo_samples.clear();
+
+  // Make the whole block available to the audio callback at once.
+  buffer->Flush();
+
+  // Devices that are synchronized by the emulator must take the samples before the buffer overflows.
+  if (buffer->Available() >= config->audio_dev->GetBlockSize() * 2) {
+    config->audio_dev->Synchronize(buffer->Available());
+  }
+
+  mmio.psg1.Run(timestamp);
+  mmio.psg2.Run(timestamp);
+  mmio.psg3.Run(timestamp);
+  mmio.psg4.Run(timestamp);
+}
+
+void APU::LatchFIFOSample(FIFOSample const& fifo_sample) {
+  auto fifo_id = fifo_sample.fifo_id;
+
+  if (config->audio.interpolate_fifo) {
+    if (fifo_sample.samplerate != fifo_samplerate[fifo_id]) {
+      fifo_resampler[fifo_id]->SetSampleRates(fifo_sample.samplerate, mmio.bias.GetSampleRate());
+      fifo_samplerate[fifo_id] = fifo_sample.samplerate;
+    }
+    fifo_resampler[fifo_id]->Write(fifo_sample.sample / 128.0);
+  } else {
+    latch[fifo_id] = fifo_sample.sample;
+  }
+}
+
+void APU::MixSample() {
   auto& bias = mmio.bias;
 
   if (bias.resolution != resolution_old) {
-    resampler->SetSampleRates(bias.GetSampleRate(),
-      config->audio_dev->GetSampleRate());
+    UpdateSampleRate();
+    mp2k.SetSampleRate(bias.GetSampleRate());
     resolution_old = mmio.bias.resolution;
     if (config->audio.interpolate_fifo) {
       for (int fifo = 0; fifo < 2; fifo++) {
@@ -128,7 +244,8 @@ void APU::StepMixer(int cycles_late) {
     }
   }
 
-  common::dsp::StereoSample<std::int16_t> sample { 0, 0 };
+  common::dsp::StereoSample<float> sample { 0, 0 };
+  float fifo_value[2];
 
   constexpr int psg_volume_tab[4] = { 1, 2, 4, 0 };
   constexpr int dma_volume_tab[2] = { 2, 4 };
@@ -144,6 +261,15 @@ void APU::StepMixer(int cycles_late) {
     }
   }
 
+  if (mp2k.IsEngaged()) {
+    auto mp2k_sample = mp2k.ReadSample();
+    fifo_value[0] = mp2k_sample.left;
+    fifo_value[1] = mp2k_sample.right;
+  } else {
+    fifo_value[0] = latch[0];
+    fifo_value[1] = latch[1];
+  }
+
   for (int channel = 0; channel < 2; channel++) {
     std::int16_t psg_sample = 0;
 
@@ -156,29 +282,50 @@ void APU::StepMixer(int cycles_late) {
 
     for (int fifo = 0; fifo < 2; fifo++) {
       if (dma[fifo].enable[channel]) {
-        sample[channel] += latch[fifo] * dma_volume_tab[dma[fifo].volume];
+        sample[channel] += fifo_value[fifo] * dma_volume_tab[dma[fifo].volume];
       }
     }
 
     sample[channel] += mmio.bias.level;
-    sample[channel]  = std::clamp(sample[channel], std::int16_t(0), std::int16_t(0x3FF));
+    sample[channel]  = std::clamp(sample[channel], 0.0f, float(0x3FF));
     sample[channel] -= 0x200;
   }
 
-  buffer_mutex.lock();
   resampler->Write({ sample[0] / float(0x200), sample[1] / float(0x200) });
-  buffer_mutex.unlock();
-
-  scheduler.Add(mmio.bias.GetSampleInterval() - cycles_late, this, &APU::StepMixer);
 }
 
 void APU::StepSequencer(int cycles_late) {
+  Sync();
+
   mmio.psg1.Tick();
   mmio.psg2.Tick();
   mmio.psg3.Tick();
   mmio.psg4.Tick();
 
-  scheduler.Add(BaseChannel::s_cycles_per_step - cycles_late, this, &APU::StepSequencer);
+  if (config->audio.dynamic_rate_control) {
+    UpdateRateControl();
+  }
+
+  scheduler.Add(BaseChannel::s_cycles_per_step - cycles_late, EventClass::APU, this, &APU::StepSequencer);
+}
+
+void APU::UpdateRateControl() {
+  static constexpr float kMaxDeviation = 0.005;
+  static constexpr float kStep = 0.001;
+
+  // Quantize the adjustment, so that the resampler is not reconfigured constantly.
+  auto target = config->audio_dev->GetBlockSize() * 2;
+  auto error  = std::clamp((target - buffer->Available()) / float(target), -1.0f, 1.0f);
+  auto adjust = 1 + std::round(error * kMaxDeviation / kStep) * kStep;
+
+  if (adjust != rate_adjust) {
+    rate_adjust = adjust;
+    UpdateSampleRate();
+  }
+}
+
+void APU::UpdateSampleRate() {
+  resampler->SetSampleRates(mmio.bias.GetSampleRate(), config->audio_dev->GetSampleRate() * rate_adjust);
 }
 
 } // namespace nba::core
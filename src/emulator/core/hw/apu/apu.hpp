@@ -9,26 +9,49 @@
 
 #include <common/dsp/resampler.hpp>
 #include <common/dsp/ring_buffer.hpp>
+#include <common/dsp/spsc_ring_buffer.hpp>
 #include <emulator/config/config.hpp>
 #include <emulator/core/hw/dma.hpp>
 #include <emulator/core/scheduler.hpp>
-#include <mutex>
+#include <atomic>
+#include <vector>
 
 #include "channel/quad_channel.hpp"
 #include "channel/wave_channel.hpp"
 #include "channel/noise_channel.hpp"
 #include "channel/fifo.hpp"
+#include "hle/mp2k.hpp"
 #include "registers.hpp"
 
 namespace nba::core {
 
+struct BootSnapshot;
+
 class APU {
 public:
   APU(Scheduler& scheduler, DMA& dma, std::shared_ptr<Config>);
 
   void Reset();
+
+  // Resets the emulated state only, the audio device and the DSP state are reused.
+  void SoftReset();
+
+  /* Only the register values are part of a boot snapshot, which is taken while the sound is disabled.
+   * LoadState() must be called after a reset, at the timestamp of the snapshot.
+   */
+  void CopyState(BootSnapshot& snapshot);
+  void LoadState(BootSnapshot const& snapshot);
+
+  void Sync();
   void OnTimerOverflow(int timer_id, int times, int samplerate);
 
+  // Returns true if overflows of the given timer feed one of the FIFOs.
+  bool IsFIFOTimer(int timer_id) const {
+    auto const& soundcnt = mmio.soundcnt;
+
+    return soundcnt.master_enable && (soundcnt.dma[0].timer_id == timer_id || soundcnt.dma[1].timer_id == timer_id);
+  }
+
   struct MMIO {
     MMIO(Scheduler& scheduler)
         : psg1(scheduler)
@@ -53,18 +76,49 @@ public:
   std::unique_ptr<common::dsp::Resampler<float>> fifo_resampler[2];
   int fifo_samplerate[2];
 
-  std::mutex buffer_mutex;
-  std::shared_ptr<common::dsp::StereoRingBuffer<float>> buffer;
+  // The buffer is only accessed by the audio callback while this is set.
+  std::atomic<bool> buffer_ready {false};
+  std::shared_ptr<common::dsp::StereoSPSCRingBuffer<float>> buffer;
   std::unique_ptr<common::dsp::StereoResampler<float>> resampler;
 
+  // Replaces the output of the FIFOs while the game's M4A mixer is emulated at a high level.
+  MP2K mp2k;
+
+  // Number of times the audio callback requested more samples than were available.
+  std::atomic<int> underruns {0};
+
 private:
-  void StepMixer(int cycles_late);
+  // A sample that was taken from a FIFO, but not yet passed on to the mixer.
+  struct FIFOSample {
+    std::uint64_t timestamp;
+    int fifo_id;
+    int samplerate;
+    std::int8_t sample;
+  };
+
+  void ResetState();
+  void Synthesize(std::uint64_t timestamp);
+  void LatchFIFOSample(FIFOSample const& fifo_sample);
+  void MixSample();
   void StepSequencer(int cycles_late);
+  void UpdateRateControl();
+  void UpdateSampleRate();
 
   Scheduler& scheduler;
   DMA& dma;
   std::shared_ptr<Config> config;
   int resolution_old = 0;
+
+  /* With dynamic rate control the output samplerate is adjusted by a small amount,
+   * so that the audio buffer stays filled to about half of its capacity.
+   */
+  float rate_adjust;
+
+  /* Audio is synthesized lazily, in blocks that span from the last synthesized sample
+   * up to the point where the result is needed or the sound state is changed.
+   */
+  std::uint64_t timestamp_next_sample;
+  std::vector<FIFOSample> fifo_samples;
 };
 
 } // namespace nba::core
@@ -7,47 +7,62 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 
 #include "apu.hpp"
 
 namespace nba::core {
 
+static void ConvertSamples(common::dsp::StereoSample<float> const* input, std::int16_t* stream, int samples) {
+  static constexpr float kMaxAmplitude = 0.999;
+
+  for (int x = 0; x < samples; x++) {
+    auto left  = std::clamp(input[x].left,  -kMaxAmplitude, kMaxAmplitude) * 32767.0f;
+    auto right = std::clamp(input[x].right, -kMaxAmplitude, kMaxAmplitude) * 32767.0f;
+
+    stream[x*2+0] = std::int16_t(std::round(left));
+    stream[x*2+1] = std::int16_t(std::round(right));
+  }
+}
+
 void AudioCallback(APU* apu, std::int16_t* stream, int byte_len) {
-  std::lock_guard<std::mutex> guard(apu->buffer_mutex);
+  static constexpr int kChunkSize = 1024;
+
+  common::dsp::StereoSample<float> chunk[kChunkSize];
+
+  int samples = byte_len/sizeof(std::int16_t)/2;
 
   // Do not try to access the buffer if it wasn't setup yet.
-  if (!apu->buffer) {
+  if (!apu->buffer_ready.load(std::memory_order_acquire)) {
+    std::memset(stream, 0, byte_len);
     return;
   }
 
-  int samples = byte_len/sizeof(std::int16_t)/2;
-  int available = apu->buffer->Available();
-
-  static constexpr float kMaxAmplitude = 0.999;
+  auto& buffer = *apu->buffer;
+  int available = buffer.Available();
 
   if (available >= samples) {
-    for (int x = 0; x < samples; x++) {
-      auto sample = apu->buffer->Read();
-      sample[0] = std::clamp(sample[0], -kMaxAmplitude, kMaxAmplitude);
-      sample[1] = std::clamp(sample[1], -kMaxAmplitude, kMaxAmplitude);
-      sample *= 32767.0;
-
-      stream[x*2+0] = std::int16_t(std::round(sample.left));
-      stream[x*2+1] = std::int16_t(std::round(sample.right));
+    while (samples > 0) {
+      int count = buffer.Read(chunk, std::min(samples, kChunkSize));
+      ConvertSamples(chunk, stream, count);
+      stream  += count * 2;
+      samples -= count;
     }
   } else {
-    int y = 0;
-
-    for (int x = 0; x < samples; x++) {
-      auto sample = apu->buffer->Peek(y);
-      sample[0] = std::clamp(sample[0], -kMaxAmplitude, kMaxAmplitude);
-      sample[1] = std::clamp(sample[1], -kMaxAmplitude, kMaxAmplitude);
-      sample *= 32767.0;
+    apu->underruns.fetch_add(1, std::memory_order_relaxed);
 
-      if (++y >= available) y = 0;
+    // Not enough samples: repeat the samples that are available, without consuming them.
+    int y = 0;
 
-      stream[x*2+0] = std::int16_t(std::round(sample.left));
-      stream[x*2+1] = std::int16_t(std::round(sample.right));
+    while (samples > 0) {
+      int count = std::min(samples, kChunkSize);
+      for (int x = 0; x < count; x++) {
+        chunk[x] = buffer.Peek(y);
+        if (++y >= available) y = 0;
+      }
+      ConvertSamples(chunk, stream, count);
+      stream  += count * 2;
+      samples -= count;
     }
   }
 }
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include "length_counter.hpp"
 #include "envelope.hpp"
 #include "sweep.hpp"
@@ -36,6 +38,23 @@ public:
     sweep.Reset();
     enabled = false;
     step = 0;
+    generating = false;
+  }
+
+  /* Runs the waveform generator up to and including the given timestamp.
+   * The generator is not driven by scheduler events, instead it catches up whenever the APU mixes a sample
+   * or before the channel state changes.
+   */
+  void Run(std::uint64_t timestamp) {
+    while (generating && timestamp_next_step <= timestamp) {
+      int interval = Generate();
+
+      if (interval == 0) {
+        generating = false;
+      } else {
+        timestamp_next_step += interval;
+      }
+    }
   }
 
   void Tick() {
@@ -49,6 +68,18 @@ public:
   }
 
 protected:
+  /* Generates the next step of the waveform.
+   * Returns the number of cycles until the next step or zero if the generator stops.
+   */
+  virtual auto Generate() -> int = 0;
+
+  void StartGenerating(std::uint64_t timestamp, int interval) {
+    if (!generating) {
+      generating = true;
+      timestamp_next_step = timestamp + interval;
+    }
+  }
+
   void Restart() {
     length.Restart();
     sweep.Restart();
@@ -68,6 +99,8 @@ protected:
 private:
   bool enabled;
   int step;
+  bool generating;
+  std::uint64_t timestamp_next_step;
 };
 
 } // namespace nba::core
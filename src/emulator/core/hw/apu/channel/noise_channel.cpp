@@ -29,10 +29,10 @@ void NoiseChannel::Reset() {
   skip_count = 0;
 }
 
-void NoiseChannel::Generate(int cycles_late) {
+auto NoiseChannel::Generate() -> int {
   if (!IsEnabled()) {
     sample = 0;
-    return;
+    return 0;
   }
 
   constexpr std::uint16_t lfsr_xor[2] = { 0x6000, 0x60 };
@@ -76,7 +76,7 @@ void NoiseChannel::Generate(int cycles_late) {
     skip_count = 0;
   }
 
-  scheduler.Add(noise_interval - cycles_late, event_cb);
+  return noise_interval;
 }
 
 auto NoiseChannel::Read(int offset) -> std::uint8_t {
@@ -152,9 +152,9 @@ void NoiseChannel::Write(int offset, std::uint8_t value) {
 
       if (dac_enable && (value & 0x80)) {
         if (!IsEnabled()) {
-          // TODO: properly handle skip count and properly align event to system clock.
+          // TODO: properly handle skip count and properly align generator to system clock.
           skip_count = 0;
-          scheduler.Add(GetSynthesisInterval(frequency_ratio, frequency_shift), event_cb);
+          StartGenerating(scheduler.GetTimestampNow(), GetSynthesisInterval(frequency_ratio, frequency_shift));
         }
 
         constexpr std::uint16_t lfsr_init[] = { 0x4000, 0x0040 };
@@ -21,11 +21,12 @@ public:
 
   void Reset();
   auto GetSample() -> std::int8_t override { return sample; }
-  void Generate(int cycles_late);
   auto Read (int offset) -> std::uint8_t;
   void Write(int offset, std::uint8_t value);
 
 private:
+  auto Generate() -> int override;
+
   constexpr int GetSynthesisInterval(int ratio, int shift) {
     int interval = 64 << shift;
 
@@ -42,9 +43,6 @@ private:
   std::int8_t sample = 0;
 
   Scheduler& scheduler;
-  std::function<void(int)> event_cb = [this](int cycles_late) {
-    this->Generate(cycles_late);
-  };
 
   int frequency_shift;
   int frequency_ratio;
@@ -23,10 +23,10 @@ void QuadChannel::Reset() {
   dac_enable = false;
 }
 
-void QuadChannel::Generate(int cycles_late) {
+auto QuadChannel::Generate() -> int {
   if (!IsEnabled()) {
     sample = 0;
-    return;
+    return 0;
   }
 
   constexpr std::int16_t pattern[4][8] = {
@@ -43,7 +43,7 @@ void QuadChannel::Generate(int cycles_late) {
   }
   phase = (phase + 1) % 8;
 
-  scheduler.Add(GetSynthesisIntervalFromFrequency(sweep.current_freq) - cycles_late, event_cb);
+  return GetSynthesisIntervalFromFrequency(sweep.current_freq);
 }
 
 auto QuadChannel::Read(int offset) -> std::uint8_t {
@@ -134,8 +134,8 @@ void QuadChannel::Write(int offset, std::uint8_t value) {
 
       if (dac_enable && (value & 0x80)) {
         if (!IsEnabled()) {
-          // TODO: properly align event to system clock.
-          scheduler.Add(GetSynthesisIntervalFromFrequency(sweep.current_freq), event_cb);
+          // TODO: properly align generator to system clock.
+          StartGenerating(scheduler.GetTimestampNow(), GetSynthesisIntervalFromFrequency(sweep.current_freq));
         }
         phase = 0;
         Restart();
@@ -20,11 +20,12 @@ public:
 
   void Reset();
   auto GetSample() -> std::int8_t override { return sample; }
-  void Generate(int cycles_late);
   auto Read (int offset) -> std::uint8_t;
   void Write(int offset, std::uint8_t value);
 
 private:
+  auto Generate() -> int override;
+
   constexpr int GetSynthesisIntervalFromFrequency(int frequency) {
     // 128 cycles equals 131072 Hz, the highest possible frequency.
     // We are dividing by eight, because the waveform can change at
@@ -33,9 +34,6 @@ private:
   }
 
   Scheduler& scheduler;
-  std::function<void(int)> event_cb = [this](int cycles_late) {
-    this->Generate(cycles_late);
-  };
 
   std::int8_t sample = 0;
   int phase;
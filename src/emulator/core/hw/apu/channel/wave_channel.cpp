@@ -35,13 +35,13 @@ void WaveChannel::Reset() {
   }
 }
 
-void WaveChannel::Generate(int cycles_late) {
+auto WaveChannel::Generate() -> int {
   if (!IsEnabled()) {
     sample = 0;
     if (BaseChannel::IsEnabled()) {
-      scheduler.Add(GetSynthesisIntervalFromFrequency(frequency) - cycles_late, event_cb);
+      return GetSynthesisIntervalFromFrequency(frequency);
     }
-    return;
+    return 0;
   }
 
   auto byte = wave_ram[wave_bank][phase / 2];
@@ -63,7 +63,7 @@ void WaveChannel::Generate(int cycles_late) {
     }
   }
 
-  scheduler.Add(GetSynthesisIntervalFromFrequency(frequency) - cycles_late, event_cb);
+  return GetSynthesisIntervalFromFrequency(frequency);
 }
 
 auto WaveChannel::Read(int offset) -> std::uint8_t {
@@ -126,8 +126,8 @@ void WaveChannel::Write(int offset, std::uint8_t value) {
 
       if (playing && (value & 0x80)) {
         if (!BaseChannel::IsEnabled()) {
-          // TODO: properly align event to system clock.
-          scheduler.Add(GetSynthesisIntervalFromFrequency(frequency), event_cb);
+          // TODO: properly align generator to system clock.
+          StartGenerating(scheduler.GetTimestampNow(), GetSynthesisIntervalFromFrequency(frequency));
         }
         phase = 0;
         if (dimension) {
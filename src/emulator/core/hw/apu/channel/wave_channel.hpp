@@ -21,7 +21,6 @@ public:
   void Reset();
   bool IsEnabled() override { return playing && BaseChannel::IsEnabled(); }
   auto GetSample() -> std::int8_t override { return sample; }
-  void Generate(int cycles_late);
   auto Read (int offset) -> std::uint8_t;
   void Write(int offset, std::uint8_t value);
 
@@ -34,15 +33,14 @@ public:
   }
 
 private:
+  auto Generate() -> int override;
+
   constexpr int GetSynthesisIntervalFromFrequency(int frequency) {
     // 8 cycles equals 2097152 Hz, the highest possible sample rate.
     return 8 * (2048 - frequency);
   }
 
   Scheduler& scheduler;
-  std::function<void(int)> event_cb = [this](int cycles_late) {
-    this->Generate(cycles_late);
-  };
 
   std::int8_t sample = 0;
   bool playing;
@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2020 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "mp2k.hpp"
+
+namespace nba::core {
+
+MP2K::MP2K() : output(0x10000, true) {
+  reverb_history = std::make_unique<float[]>(s_reverb_length);
+  Reset();
+}
+
+void MP2K::Reset() {
+  // The reverb history is only written to while the mixer is engaged.
+  if (engaged) {
+    std::fill_n(reverb_history.get(), s_reverb_length, 0);
+  }
+  engaged = false;
+  frame_length = 0;
+  frame_fraction = 0;
+  reverb_index = 0;
+  output.Reset();
+  output_last = {};
+}
+
+void MP2K::SetSampleRate(int sample_rate) {
+  this->sample_rate = sample_rate;
+}
+
+auto MP2K::SoundMainRAM(M4ASoundInfo& sound_info, Translate const& translate, std::uint64_t timestamp) -> bool {
+  int samples_per_frame = sound_info.pcmSamplesPerVBlank;
+  int max_channels = std::min<int>(sound_info.maxChans, kM4AMaxDirectSoundChannels);
+
+  if (samples_per_frame <= 0 || sound_info.pcmFreq <= 0) {
+    return false;
+  }
+
+  /* Compressed and reversed samples (supported by some later engine versions) are not rendered natively.
+   * Leave the frame to the game's mixer while any such channel is playing, so that it does not go silent.
+   */
+  for (int i = 0; i < max_channels; i++) {
+    auto& channel = sound_info.channels[i];
+
+    if ((channel.status & CHANNEL_ON) != 0 && (channel.type & 0x30) != 0) {
+      Reset();
+      return false;
+    }
+  }
+
+  /* The engine mixes a fixed number of samples per call, but the game restarts the sound DMA every couple of frames.
+   * Render as much audio as was played back since the last call, unless the engine was paused in between.
+   */
+  double length = double(samples_per_frame) * sample_rate / sound_info.pcmFreq;
+
+  if (engaged) {
+    double elapsed = double(timestamp - timestamp_last) * sample_rate / 16777216.0;
+    if (elapsed < length * 2) {
+      length = elapsed;
+    }
+  }
+
+  timestamp_last = timestamp;
+  frame_fraction += length;
+  frame_length = int(frame_fraction);
+  frame_fraction -= frame_length;
+
+  if (!engaged) {
+    // Start out with one frame of latency, to absorb jitter in the timing of the calls.
+    for (int i = 0; i < frame_length; i++) {
+      output.Write({});
+    }
+    engaged = true;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    mix[i].assign(frame_length, 0);
+  }
+
+  RenderReverb(sound_info.reverb, sound_info.pcmDmaPeriod);
+
+  int master_volume = sound_info.masterVolume + 1;
+
+  for (int i = 0; i < max_channels; i++) {
+    auto& channel = sound_info.channels[i];
+
+    if ((channel.status & CHANNEL_ON) == 0) {
+      continue;
+    }
+
+    auto wave = reinterpret_cast<M4AWaveData*>(translate(channel.wav, sizeof(M4AWaveData)));
+
+    if (wave == nullptr) {
+      channel.status = 0;
+      continue;
+    }
+
+    if (!StepEnvelope(channel, *wave)) {
+      continue;
+    }
+
+    int volume = master_volume * channel.ev >> 4;
+
+    channel.er = channel.rightVolume * volume >> 8;
+    channel.el = channel.leftVolume  * volume >> 8;
+
+    // The distance between two engine samples, in 9.23 fixed-point. Fixed frequency channels play at the engine samplerate.
+    std::uint32_t step = 0x800000;
+
+    if ((channel.type & 8) == 0) {
+      step = channel.freq * std::uint32_t(sound_info.divFreq);
+    }
+
+    auto data = reinterpret_cast<std::int8_t*>(translate(channel.wav + sizeof(M4AWaveData), wave->size));
+
+    if (data != nullptr && frame_length != 0) {
+      RenderChannel(channel, *wave, data, double(step) / 0x800000 * samples_per_frame / frame_length);
+    }
+
+    AdvanceChannel(channel, *wave, std::uint64_t(step) * samples_per_frame);
+  }
+
+  WriteOutput();
+  return true;
+}
+
+auto MP2K::ReadSample() -> common::dsp::StereoSample<float> {
+  if (output.Available() != 0) {
+    output_last = output.Read();
+  }
+  return output_last;
+}
+
+/* Steps the envelope of a channel once per frame, like the engine's mixer does.
+ * Returns false if the channel has been stopped.
+ */
+auto MP2K::StepEnvelope(M4ASoundChannel& channel, M4AWaveData const& wave) -> bool {
+  int status = channel.status;
+  int envelope = channel.ev;
+
+  if (status & CHANNEL_START) {
+    if (status & CHANNEL_STOP) {
+      channel.status = 0;
+      return false;
+    }
+
+    status = CHANNEL_ENV_ATTACK;
+    if (wave.status & 0xC000) {
+      status |= CHANNEL_LOOP;
+    }
+
+    channel.cp = channel.wav + sizeof(M4AWaveData);
+    channel.ct = wave.size;
+    channel.fw = 0;
+    envelope = 0;
+  } else if (status & CHANNEL_ECHO) {
+    if (channel.echoLength-- <= 1) {
+      channel.status = 0;
+      return false;
+    }
+  } else if (status & CHANNEL_STOP) {
+    envelope = envelope * channel.release >> 8;
+    if (envelope <= channel.echoVolume) {
+      if (channel.echoVolume == 0) {
+        channel.status = 0;
+        return false;
+      }
+      envelope = channel.echoVolume;
+      status |= CHANNEL_ECHO;
+    }
+  } else if ((status & CHANNEL_ENV_MASK) == CHANNEL_ENV_DECAY) {
+    envelope = envelope * channel.decay >> 8;
+    if (envelope <= channel.sustain) {
+      envelope = channel.sustain;
+      if (envelope == 0) {
+        if (channel.echoVolume == 0) {
+          channel.status = 0;
+          return false;
+        }
+        envelope = channel.echoVolume;
+        status |= CHANNEL_ECHO;
+      } else {
+        status--;
+      }
+    }
+  }
+
+  if ((status & (CHANNEL_ECHO | CHANNEL_STOP | CHANNEL_ENV_MASK)) == CHANNEL_ENV_ATTACK) {
+    envelope += channel.attack;
+    if (envelope > 0xFE) {
+      envelope = 0xFF;
+      status--;
+    }
+  }
+
+  channel.status = status;
+  channel.ev = envelope;
+  return true;
+}
+
+void MP2K::RenderChannel(M4ASoundChannel const& channel, M4AWaveData const& wave, std::int8_t const* data, double step) {
+  bool loop = (channel.status & CHANNEL_LOOP) && wave.size > wave.loopStart;
+
+  double position = std::int64_t(channel.cp) - std::int64_t(channel.wav + sizeof(M4AWaveData));
+  position += channel.fw / double(0x800000);
+
+  int length = frame_length;
+
+  // Unlooped samples end within the frame once the position passes the end of the sample.
+  if (!loop) {
+    length = int(std::clamp(std::ceil((wave.size - position) / step), 0.0, double(frame_length)));
+    if (length == 0) {
+      return;
+    }
+  }
+
+  // The spline reads one sample before and two samples after the position.
+  auto first = std::int64_t(std::floor(position)) - 1;
+  auto last = std::int64_t(position + (length - 1) * step) + 3;
+
+  UnrollSamples(wave, data, loop, first, last - first + 1);
+
+  // The engine mixes the right channel into FIFO A and the left channel into FIFO B.
+  float volume_a = channel.er / 256.0f;
+  float volume_b = channel.el / 256.0f;
+  float* mix_a = mix[0].data();
+  float* mix_b = mix[1].data();
+  std::int32_t const* source = this->source.data();
+  float offset = float(position - first);
+  float step_f = float(step);
+
+  for (int i = 0; i < length; i++) {
+    float x = offset + i * step_f;
+    int index = int(x);
+    float t = x - index;
+    float a = float(source[index - 1]);
+    float b = float(source[index + 0]);
+    float c = float(source[index + 1]);
+    float d = float(source[index + 2]);
+
+    // Catmull-Rom spline through the four closest samples.
+    float sample = b + 0.5f * t * (c - a + t * (2 * a - 5 * b + 4 * c - d + t * (3 * (b - c) + d - a)));
+
+    mix_a[i] += sample * volume_a;
+    mix_b[i] += sample * volume_b;
+  }
+}
+
+/* Copies the samples [first, first + count) of a channel into the source buffer in the order they are played,
+ * with the loop unrolled and silence before the start and past the end of the sample.
+ * The loop is handled in whole spans, so that rendering reads the buffer without any wrapping.
+ */
+void MP2K::UnrollSamples(M4AWaveData const& wave, std::int8_t const* data, bool loop, std::int64_t first, std::int64_t count) {
+  std::int64_t size = wave.size;
+  std::int64_t loop_start = wave.loopStart;
+  std::int64_t index = first;
+  std::int64_t i = 0;
+
+  source.resize(count);
+
+  if (index < 0) {
+    i = std::min(-index, count);
+    std::fill_n(source.begin(), i, 0);
+    index = 0;
+  }
+
+  while (i < count) {
+    if (index >= size) {
+      if (!loop) {
+        std::fill(source.begin() + i, source.end(), 0);
+        break;
+      }
+      index = loop_start + (index - size) % (size - loop_start);
+    }
+
+    auto span = std::min(size - index, count - i);
+
+    std::copy_n(data + index, span, source.begin() + i);
+    index += span;
+    i += span;
+  }
+}
+
+// Advances the sample position of a channel by the given distance (in 9.23 fixed-point), like the engine's mixer does.
+void MP2K::AdvanceChannel(M4ASoundChannel& channel, M4AWaveData const& wave, std::uint64_t distance) {
+  auto position = channel.fw + distance;
+  auto samples = std::int64_t(position >> 23);
+  auto count = std::int64_t(channel.ct) - samples;
+
+  channel.fw = position & 0x7FFFFF;
+  channel.cp += samples;
+
+  if (count <= 0) {
+    std::int64_t loop_length = std::int64_t(wave.size) - wave.loopStart;
+
+    if ((channel.status & CHANNEL_LOOP) && loop_length > 0) {
+      auto wraps = -count / loop_length + 1;
+      count += wraps * loop_length;
+      channel.cp -= wraps * loop_length;
+    } else {
+      channel.status = 0;
+      count = 0;
+    }
+  }
+
+  channel.ct = count;
+}
+
+/* The engine initializes each new frame with a mix of the two frames that were output
+ * one and two DMA periods ago, scaled by the reverb level.
+ */
+void MP2K::RenderReverb(int reverb, int period) {
+  if (reverb == 0 || period < 2 || (period + 1) * frame_length > s_reverb_length) {
+    return;
+  }
+
+  float gain = reverb / 512.0f;
+  int delay1 = period * frame_length;
+  int delay2 = (period - 1) * frame_length;
+
+  for (int i = 0; i < frame_length; i++) {
+    int index = reverb_index + i;
+    float value = (reverb_history[(index - delay1) & (s_reverb_length - 1)] +
+                   reverb_history[(index - delay2) & (s_reverb_length - 1)]) * gain;
+
+    mix[0][i] = value;
+    mix[1][i] = value;
+  }
+}
+
+void MP2K::WriteOutput() {
+  // Keep the latency bounded, in case the game calls the mixer more often than expected.
+  while (output.Available() > frame_length * 2) {
+    output.Read();
+  }
+
+  for (int i = 0; i < frame_length; i++) {
+    float a = std::clamp(mix[0][i], -128.0f, 127.0f);
+    float b = std::clamp(mix[1][i], -128.0f, 127.0f);
+
+    reverb_history[(reverb_index + i) & (s_reverb_length - 1)] = a + b;
+    output.Write({ a, b });
+  }
+
+  reverb_index = (reverb_index + frame_length) & (s_reverb_length - 1);
+}
+
+} // namespace nba::core
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2020 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <common/dsp/ring_buffer.hpp>
+#include <common/m4a.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace nba::core {
+
+/* High-level emulation of the M4A (MP2K, "Sappy") software mixer.
+ * SoundMainRAM() takes the place of the game's mixer routine: it steps the channel envelopes
+ * and sample positions exactly like the game would, but renders the channels natively
+ * at the samplerate of the APU mixer instead of the engine's samplerate.
+ */
+class MP2K {
+public:
+  // Returns a host pointer to the given range of guest memory or nullptr if it cannot be accessed.
+  using Translate = std::function<std::uint8_t*(std::uint32_t address, std::uint32_t size)>;
+
+  MP2K();
+
+  void Reset();
+  void SetSampleRate(int sample_rate);
+
+  bool IsEngaged() const { return engaged; }
+
+  // Returns false if the frame has to be mixed by the game's own mixer instead.
+  auto SoundMainRAM(M4ASoundInfo& sound_info, Translate const& translate, std::uint64_t timestamp) -> bool;
+
+  // Reads the next sample, left is the output for FIFO A and right is the output for FIFO B.
+  auto ReadSample() -> common::dsp::StereoSample<float>;
+
+private:
+  enum ChannelStatus {
+    CHANNEL_ENV_MASK = 0x03,
+    CHANNEL_ENV_SUSTAIN = 0x01,
+    CHANNEL_ENV_DECAY = 0x02,
+    CHANNEL_ENV_ATTACK = 0x03,
+    CHANNEL_ECHO = 0x04,
+    CHANNEL_LOOP = 0x10,
+    CHANNEL_STOP = 0x40,
+    CHANNEL_START = 0x80,
+    CHANNEL_ON = CHANNEL_START | CHANNEL_STOP | CHANNEL_ECHO | CHANNEL_ENV_MASK
+  };
+
+  static constexpr int s_reverb_length = 0x40000;
+
+  auto StepEnvelope(M4ASoundChannel& channel, M4AWaveData const& wave) -> bool;
+  void RenderChannel(M4ASoundChannel const& channel, M4AWaveData const& wave, std::int8_t const* data, double step);
+  void UnrollSamples(M4AWaveData const& wave, std::int8_t const* data, bool loop, std::int64_t first, std::int64_t count);
+  void AdvanceChannel(M4ASoundChannel& channel, M4AWaveData const& wave, std::uint64_t distance);
+  void RenderReverb(int reverb, int period);
+  void WriteOutput();
+
+  bool engaged = false;
+  int sample_rate = 32768;
+  int frame_length;
+  double frame_fraction;
+  std::uint64_t timestamp_last;
+
+  /* Mix buffers for FIFO A and FIFO B and the unrolled samples of the channel that is being rendered.
+   * The samples are stored as integers, so that the compiler knows they cannot alias the mix buffers.
+   */
+  std::vector<float> mix[2];
+  std::vector<std::int32_t> source;
+
+  // Mono output history, to emulate the engine's reverb which feeds back from previous frames.
+  std::unique_ptr<float[]> reverb_history;
+  int reverb_index;
+
+  common::dsp::StereoRingBuffer<float> output;
+  common::dsp::StereoSample<float> output_last;
+};
+
+} // namespace nba::core
@@ -6,6 +6,7 @@
  */
 
 #include <common/likely.hpp>
+#include <emulator/core/boot_snapshot.hpp>
 #include <emulator/core/cpu-mmio.hpp>
 
 #include "dma.hpp"
@@ -24,6 +25,9 @@ static constexpr int g_dma_dst_modify[2][4] = {
 
 static constexpr int g_dma_none_id = -1;
 
+// NOTE: a bulk transfer is not worth it if only a handful of units fit before the next event.
+static constexpr int g_dma_bulk_min_cycles = 64;
+
 // NOTE: Retrieves DMA with highest priority from a DMA bitset.
 static constexpr int g_dma_from_bitset[] = {
   /* 0b0000 */ g_dma_none_id,
@@ -74,7 +78,7 @@ void DMA::ScheduleDMAs(unsigned int bitset) {
   while (bitset > 0) {
     auto chan_id = g_dma_from_bitset[bitset];
     bitset &= ~(1 << chan_id);
-    channels[chan_id].startup_event = scheduler.Add(2, [this, chan_id](int cycles_late) {
+    channels[chan_id].startup_event = scheduler.Add(2, EventClass::DMA, [this, chan_id](int cycles_late) {
       channels[chan_id].startup_event = nullptr;
       if (runnable_set.none()) {
         active_dma_id = chan_id;
@@ -133,10 +137,15 @@ void DMA::StopVideoXferDMA() {
 void DMA::Run() {
   if (!IsRunning())
     return;
-  RunChannel(true);
-  while (IsRunning()) {
-    RunChannel(false);
-  }
+  bool first = true;
+
+  do {
+    auto id = active_dma_id;
+    auto timestamp = scheduler.GetTimestampNow();
+    RunChannel(first);
+    NBA_STATS_ADD(stats.dma_cycles[id], scheduler.GetTimestampNow() - timestamp);
+    first = false;
+  } while (IsRunning());
 }
 
 void DMA::RunChannel(bool first) {
@@ -166,12 +175,35 @@ void DMA::RunChannel(bool first) {
     memory.Idle();
   }
 
+  /* Immediate, H-blank and V-blank transfers between plain memory areas are done in bulk,
+   * up to the next scheduler event. The first unit always goes the slow way.
+   */
+  bool bulk = bulk_transfer && !channel.is_fifo_dma && channel.time != Channel::Special;
+
   while (channel.latch.length != 0) {
     if (early_exit_trigger) {
       early_exit_trigger = false;
       return;
     }
 
+    if (bulk && access == Access::Sequential && channel.latch.length > 1 &&
+        scheduler.GetRemainingCycleCount() > g_dma_bulk_min_cycles) {
+      int count = bulk_transfer(channel.latch.src_addr, channel.latch.dst_addr, src_modify, dst_modify,
+                                channel.latch.length, size == Channel::Word, channel.latch.bus);
+
+      if (count > 0) {
+        latch = channel.latch.bus;
+        channel.latch.src_addr += src_modify * count;
+        channel.latch.dst_addr += dst_modify * count;
+        channel.latch.length -= count;
+        continue;
+      }
+
+      if (count < 0) {
+        bulk = false;
+      }
+    }
+
     if (size == Channel::Half) {
       std::uint16_t value;
 
@@ -304,6 +336,73 @@ void DMA::Write(int chan_id, int offset, std::uint8_t value) {
   }
 }
 
+void DMA::WriteHalf(int chan_id, int offset, std::uint16_t value) {
+  auto& channel = channels[chan_id];
+
+  switch (offset) {
+    case REG_DMAXSAD | 0:
+    case REG_DMAXSAD | 2: {
+      int shift = offset * 8;
+      channel.src_addr &= ~(0xFFFFUL << shift);
+      channel.src_addr |= (std::uint32_t(value) << shift) & g_dma_src_mask[chan_id];
+      break;
+    }
+    case REG_DMAXDAD | 0:
+    case REG_DMAXDAD | 2: {
+      int shift = (offset - 4) * 8;
+      channel.dst_addr &= ~(0xFFFFUL << shift);
+      channel.dst_addr |= (std::uint32_t(value) << shift) & g_dma_dst_mask[chan_id];
+      break;
+    }
+    case REG_DMAXCNT_L: channel.length = value; break;
+    case REG_DMAXCNT_H: {
+      // Only the upper byte has side effects.
+      Write(chan_id, REG_DMAXCNT_H | 0, value & 0xFF);
+      Write(chan_id, REG_DMAXCNT_H | 1, value >> 8);
+      break;
+    }
+  }
+}
+
+void DMA::CopyState(BootSnapshot& snapshot) {
+  for (int id = 0; id < 4; id++) {
+    auto const& channel = channels[id];
+    auto& state = snapshot.dma.channels[id];
+
+    state.src_addr = channel.src_addr;
+    state.dst_addr = channel.dst_addr;
+    state.length = channel.length;
+    state.control = Read(id, REG_DMAXCNT_H) | (Read(id, REG_DMAXCNT_H | 1) << 8);
+    state.latch.length = channel.latch.length;
+    state.latch.dst_addr = channel.latch.dst_addr;
+    state.latch.src_addr = channel.latch.src_addr;
+    state.latch.bus = channel.latch.bus;
+  }
+
+  snapshot.dma.latch = latch;
+}
+
+void DMA::LoadState(BootSnapshot const& snapshot) {
+  for (int id = 0; id < 4; id++) {
+    auto& channel = channels[id];
+    auto const& state = snapshot.dma.channels[id];
+
+    channel.src_addr = state.src_addr;
+    channel.dst_addr = state.dst_addr;
+    channel.length = state.length;
+
+    // Enabled channels which wait for their start condition are armed again.
+    WriteHalf(id, REG_DMAXCNT_H, state.control);
+
+    channel.latch.length = state.latch.length;
+    channel.latch.dst_addr = state.latch.dst_addr;
+    channel.latch.src_addr = state.latch.src_addr;
+    channel.latch.bus = state.latch.bus;
+  }
+
+  latch = snapshot.dma.latch;
+}
+
 void DMA::OnChannelWritten(Channel& channel, bool enable_old) {
   // If the DMA is enabled this information will be regenerated below.
   hblank_set.set(channel.id, false);
@@ -9,20 +9,31 @@
 
 #include <bitset>
 #include <cstdint>
+#include <functional>
 #include <emulator/core/arm/memory.hpp>
 #include <emulator/core/hw/interrupt.hpp>
 #include <emulator/core/scheduler.hpp>
 
 namespace nba::core {
 
+struct BootSnapshot;
+
 class DMA {
 public:
   using Access = arm::MemoryBase::Access;
 
-  DMA(arm::MemoryBase& memory, IRQ& irq, Scheduler& scheduler)
+  /* Moves up to count units (words or halfwords) between plain memory areas at once,
+   * without any scheduler event firing in between. Returns the number of units that were moved
+   * (and stores the last value read in bus) or -1 if the transfer cannot be done in bulk.
+   */
+  using BulkTransfer = std::function<int(std::uint32_t src_addr, std::uint32_t dst_addr, int src_modify,
+                                         int dst_modify, int count, bool word, std::uint32_t& bus)>;
+
+  DMA(arm::MemoryBase& memory, IRQ& irq, Scheduler& scheduler, Stats& stats)
       : memory(memory)
       , irq(irq)
-      , scheduler(scheduler) {
+      , scheduler(scheduler)
+      , stats(stats) {
     Reset();
   }
 
@@ -40,8 +51,12 @@ public:
   void Run();
   auto Read (int chan_id, int offset) -> std::uint8_t;
   void Write(int chan_id, int offset, std::uint8_t value);
+  void WriteHalf(int chan_id, int offset, std::uint16_t value);
+  void CopyState(BootSnapshot& snapshot);
+  void LoadState(BootSnapshot const& snapshot);
   bool IsRunning() { return runnable_set.any(); }
   auto GetOpenBusValue() -> std::uint32_t { return latch; }
+  void SetBulkTransfer(BulkTransfer bulk_transfer) { this->bulk_transfer = bulk_transfer; }
 
 private:
   enum Registers {
@@ -114,6 +129,8 @@ private:
   arm::MemoryBase& memory;
   IRQ& irq;
   Scheduler& scheduler;
+  Stats& stats;
+  BulkTransfer bulk_transfer;
 
   int active_dma_id;
   bool early_exit_trigger;
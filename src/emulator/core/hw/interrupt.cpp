@@ -5,6 +5,8 @@
  * Refer to the included LICENSE file.
  */
 
+#include <emulator/core/boot_snapshot.hpp>
+
 #include "interrupt.hpp"
 
 namespace nba::core {
@@ -45,6 +47,32 @@ void IRQ::Write(int offset, std::uint8_t value) {
   UpdateIRQLine();
 }
 
+auto IRQ::ReadHalf(int offset) const -> std::uint16_t {
+  switch (offset) {
+    case REG_IE:  return reg_ie;
+    case REG_IF:  return reg_if;
+    case REG_IME: return reg_ime ? 1 : 0;
+  }
+
+  return 0;
+}
+
+void IRQ::WriteHalf(int offset, std::uint16_t value) {
+  switch (offset) {
+    case REG_IE:
+      reg_ie = value;
+      break;
+    case REG_IF:
+      reg_if &= ~value;
+      break;
+    case REG_IME:
+      reg_ime = value & 1;
+      break;
+  }
+
+  UpdateIRQLine();
+}
+
 void IRQ::Raise(IRQ::Source source, int channel) {
   switch (source) {
     case Source::VBlank:
@@ -76,6 +104,21 @@ void IRQ::Raise(IRQ::Source source, int channel) {
   UpdateIRQLine();
 }
 
+void IRQ::CopyState(BootSnapshot& snapshot) const {
+  snapshot.irq.ime = reg_ime;
+  snapshot.irq.ie = reg_ie;
+  snapshot.irq.if_ = reg_if;
+}
+
+void IRQ::LoadState(BootSnapshot const& snapshot) {
+  reg_ime = snapshot.irq.ime;
+  reg_ie = snapshot.irq.ie;
+  reg_if = snapshot.irq.if_;
+
+  // The IRQ line had settled when the snapshot was taken.
+  cpu.IRQLine() = MasterEnable() && HasServableIRQ();
+}
+
 void IRQ::UpdateIRQLine() {
   bool irq_line = MasterEnable() && HasServableIRQ();
 
@@ -83,7 +126,7 @@ void IRQ::UpdateIRQLine() {
     if (event != nullptr) {
       scheduler.Cancel(event);
     }
-    event = scheduler.Add(1, [=](int late) {
+    event = scheduler.Add(1, EventClass::IRQ, [=](int late) {
       cpu.IRQLine() = irq_line;
       event = nullptr;
     });
@@ -13,6 +13,8 @@
 
 namespace nba::core {
 
+struct BootSnapshot;
+
 class IRQ {
 public:
   enum class Source {
@@ -42,7 +44,11 @@ public:
 
   auto Read(int offset) const -> std::uint8_t;
   void Write(int offset, std::uint8_t value);
+  auto ReadHalf(int offset) const -> std::uint16_t;
+  void WriteHalf(int offset, std::uint16_t value);
   void Raise(IRQ::Source source, int channel = 0);
+  void CopyState(BootSnapshot& snapshot) const;
+  void LoadState(BootSnapshot const& snapshot);
 
   bool MasterEnable() const {
     return reg_ime != 0;
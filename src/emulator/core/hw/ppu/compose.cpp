@@ -24,17 +24,129 @@ auto PPU::ConvertColor(std::uint16_t color) -> std::uint32_t {
          0xFF000000;
 }
 
+auto PPU::ConvertColorRGB565(std::uint16_t color) -> std::uint16_t {
+  int r = (color >>  0) & 0x1F;
+  int g = (color >>  5) & 0x1F;
+  int b = (color >> 10) & 0x1F;
+
+  return r << 11 |
+         g <<  6 | (g >> 4) << 5 |
+         b;
+}
+
+/* Converts the BGR555 frame to the configured pixel format and hands it to the video device.
+ * The loops are kept free of branches, so that the compiler can vectorize them.
+ */
+void PPU::PresentFrame() {
+  auto format = config->video.pixel_format;
+
+  // Indexed8 frames which fell back to BGR555 would do so again.
+  bool same_format = frame.format == format ||
+    (format == PixelFormat::Indexed8 && frame.format == PixelFormat::BGR555);
+
+  if (frame_unchanged && same_format) {
+    frame.unchanged = true;
+    config->video_dev->Draw(frame);
+    return;
+  }
+
+  frame.unchanged = false;
+  frame.format = format;
+  frame.width = 240;
+  frame.height = 160;
+  frame.palette = nullptr;
+  frame.palette_size = 0;
+
+  if (format == PixelFormat::Indexed8 && !ConvertFrameIndexed8()) {
+    format = PixelFormat::BGR555;
+    frame.format = format;
+  }
+
+  switch (format) {
+    case PixelFormat::ARGB8888: {
+      auto data = reinterpret_cast<std::uint32_t*>(frame_data.get());
+      for (int i = 0; i < 240 * 160; i++) {
+        data[i] = ConvertColor(output[i]);
+      }
+      frame.stride = 240 * sizeof(std::uint32_t);
+      frame.data = data;
+      break;
+    }
+    case PixelFormat::RGB565: {
+      auto data = reinterpret_cast<std::uint16_t*>(frame_data.get());
+      for (int i = 0; i < 240 * 160; i++) {
+        data[i] = ConvertColorRGB565(output[i]);
+      }
+      frame.stride = 240 * sizeof(std::uint16_t);
+      frame.data = data;
+      break;
+    }
+    case PixelFormat::BGR555: {
+      frame.stride = 240 * sizeof(std::uint16_t);
+      frame.data = output;
+      break;
+    }
+    case PixelFormat::Indexed8: {
+      frame.stride = 240;
+      frame.data = frame_data.get();
+      frame.palette = frame_palette;
+      frame.palette_size = frame_palette_size;
+      break;
+    }
+  }
+
+  config->video_dev->Draw(frame);
+}
+
+/* Builds a palette of the colors used by the frame and maps each pixel to its palette index.
+ * Returns false if the frame uses more than 256 colors and thus cannot be represented.
+ */
+auto PPU::ConvertFrameIndexed8() -> bool {
+  auto data = frame_data.get();
+  bool success = true;
+
+  frame_palette_size = 0;
+
+  for (int i = 0; i < 240 * 160; i++) {
+    auto color = output[i];
+    auto index = frame_color_index[color];
+
+    if (index < 0) {
+      if (frame_palette_size == 256) {
+        success = false;
+        break;
+      }
+      index = frame_palette_size++;
+      frame_color_index[color] = index;
+      frame_palette[index] = color;
+    }
+
+    data[i] = std::uint8_t(index);
+  }
+
+  // Leave the lookup table clean for the next frame.
+  for (int i = 0; i < frame_palette_size; i++) {
+    frame_color_index[frame_palette[i]] = -1;
+  }
+
+  return success;
+}
+
 void PPU::RenderScanline() {
   std::uint16_t  vcount = mmio.vcount;
-  std::uint32_t* line = &output[vcount * 240];
+  std::uint16_t* line = &output[vcount * 240];
 
   if (mmio.dispcnt.forced_blank) {
     for (int x = 0; x < 240; x++) {
-      line[x] = ConvertColor(0x7FFF);
+      line[x] = 0x7FFF;
     }
     return;
   }
 
+  if (mmio.dispcnt.mode >= 3 && mmio.dispcnt.mode <= 5 && RenderBitmapDirect()) {
+    return;
+  }
+
   switch (mmio.dispcnt.mode) {
     // BG Mode 0 - 240x160 pixels, Text mode
     case 0: {
@@ -97,7 +209,7 @@ void PPU::RenderScanline() {
     case 6:
     case 7: {
       // TODO: do OBJs still work in this mode?
-      std::uint32_t backdrop = ConvertColor(ReadPalette(0, 0));
+      std::uint16_t backdrop = ReadPalette(0, 0);
       for (int x = 0; x < 240; x++) {
         line[x] = backdrop;
       }
@@ -108,7 +220,7 @@ void PPU::RenderScanline() {
 
 template<bool window, bool blending>
 void PPU::ComposeScanlineTmpl(int bg_min, int bg_max) {
-  std::uint32_t* line = &output[mmio.vcount * 240];
+  std::uint16_t* line = &output[mmio.vcount * 240];
   std::uint16_t backdrop = ReadPalette(0, 0);
 
   auto const& dispcnt = mmio.dispcnt;
@@ -257,7 +369,7 @@ void PPU::ComposeScanlineTmpl(int bg_min, int bg_max) {
       }
     }
 
-    line[x] = ConvertColor(pixel[0]);
+    line[x] = pixel[0] & 0x7FFF;
   }
 }
 
@@ -5,25 +5,65 @@
  * Refer to the included LICENSE file.
  */
 
+#include <algorithm>
 #include <cstring>
+#include <emulator/core/boot_snapshot.hpp>
 
 #include "ppu.hpp"
 
 namespace nba::core {
 
-PPU::PPU(Scheduler& scheduler, IRQ& irq, DMA& dma, std::shared_ptr<Config> config)
+PPU::PPU(Scheduler& scheduler, IRQ& irq, DMA& dma, Stats& stats, std::shared_ptr<Config> config)
     : scheduler(scheduler)
     , irq(irq)
     , dma(dma)
+    , stats(stats)
     , config(config) {
+  frame_data = std::make_unique<std::uint8_t[]>(240 * 160 * sizeof(std::uint32_t));
+  frame_color_index = std::make_unique<std::int16_t[]>(32768);
+  std::fill_n(frame_color_index.get(), 32768, -1);
   Reset();
   mmio.dispstat.ppu = this;
 }
 
+PPU::~PPU() {
+  StopRenderThreads();
+}
+
 void PPU::Reset() {
+  StopRenderThreads();
+  ResetState();
+
+  if (config->video.render_mode != Config::Video::RenderMode::Inline) {
+    StartRenderThreads();
+  }
+}
+
+void PPU::SoftReset() {
+  if (!renderer.running || renderer.mode != config->video.render_mode) {
+    Reset();
+    return;
+  }
+
+  // Keep the render threads, but bring their copies of the PPU state up to date.
+  DiscardRenderJobs();
+  ResetState();
+  for (auto& worker : renderer.workers) {
+    worker.ppu->CopyRenderState(*this);
+  }
+}
+
+void PPU::ResetState() {
   std::memset(pram, 0, 0x00400);
   std::memset(oam,  0, 0x00400);
   std::memset(vram, 0, 0x18000);
+  oam_dirty = true;
+
+  frame_dirty = true;
+  frame_dirty_last = true;
+  frame_unchanged = false;
+  skipped_oam.pending = false;
+  std::fill_n(register_value, 0x56, 0xFFFF);
 
   mmio.dispcnt.Reset();
   mmio.dispstat.Reset();
@@ -58,7 +98,114 @@ void PPU::Reset() {
   mmio.evy = 0;
   mmio.bldcnt.Reset();
 
-  scheduler.Add(1006, this, &PPU::OnScanlineComplete);
+  scheduler.Add(1006, EventClass::PPU, this, &PPU::OnScanlineComplete);
+}
+
+void PPU::CopyState(BootSnapshot& snapshot) const {
+  std::memcpy(snapshot.ppu.pram, pram, sizeof(pram));
+  std::memcpy(snapshot.ppu.oam,  oam,  sizeof(oam));
+  std::memcpy(snapshot.ppu.vram, vram, sizeof(vram));
+  snapshot.ppu.mmio = mmio;
+}
+
+void PPU::LoadState(BootSnapshot const& snapshot) {
+  std::memcpy(pram, snapshot.ppu.pram, sizeof(pram));
+  std::memcpy(oam,  snapshot.ppu.oam,  sizeof(oam));
+  std::memcpy(vram, snapshot.ppu.vram, sizeof(vram));
+  oam_dirty = true;
+
+  mmio = snapshot.ppu.mmio;
+  mmio.dispstat.ppu = this;
+
+  // Scanlines are 1232 cycles long and follow each other without a gap since the reset.
+  int cycle = scheduler.GetTimestampNow() % 1232;
+
+  if (mmio.vcount < 160) {
+    if (cycle < 1006) {
+      scheduler.Add(1006 - cycle, EventClass::PPU, this, &PPU::OnScanlineComplete);
+    } else {
+      scheduler.Add(1232 - cycle, EventClass::PPU, this, &PPU::OnHblankComplete);
+    }
+  } else {
+    if (cycle < 1006) {
+      scheduler.Add(1006 - cycle, EventClass::PPU, this, &PPU::OnVblankScanlineComplete);
+    } else {
+      scheduler.Add(1232 - cycle, EventClass::PPU, this, &PPU::OnVblankHblankComplete);
+    }
+  }
+
+  for (auto& worker : renderer.workers) {
+    worker.ppu->CopyRenderState(*this);
+  }
+}
+
+void PPU::OnRegisterWrite(std::uint32_t address, std::uint8_t value) {
+  address &= 0xFF;
+
+  // DISPSTAT and VCOUNT do not affect the image.
+  if (address >= 0x04 && address <= 0x07) {
+    return;
+  }
+
+  /* Writing BGX, BGY or MOSAIC resets internal state even if the value stays the same.
+   * During V-Blank that state is reset anyways.
+   */
+  bool resets_state = (address >= 0x28 && address <= 0x3F) || address == 0x4C || address == 0x4D;
+
+  if (register_value[address] == value && !(resets_state && mmio.vcount < 160)) {
+    return;
+  }
+
+  register_value[address] = value;
+  MarkFrameDirty();
+}
+
+void PPU::OnFrameDirty() {
+  frame_dirty = true;
+
+  if (skipped_oam.pending) {
+    auto mosaic_y = mmio.mosaic.obj._counter_y;
+
+    skipped_oam.pending = false;
+    mmio.mosaic.obj._counter_y = skipped_oam.mosaic_y;
+    Render(false, true, skipped_oam.line);
+    mmio.mosaic.obj._counter_y = mosaic_y;
+  }
+}
+
+void PPU::Render(bool scanline, bool oam, int oam_line) {
+  if (!scanline && !oam) {
+    return;
+  }
+
+  if (!frame_dirty && !frame_dirty_last) {
+    if (scanline) {
+      NBA_STATS_ADD(stats.scanlines_skipped, 1);
+    }
+    if (oam) {
+      skipped_oam.pending = true;
+      skipped_oam.line = oam_line;
+      skipped_oam.mosaic_y = mmio.mosaic.obj._counter_y;
+    }
+    return;
+  }
+
+  if (scanline) {
+    NBA_STATS_ADD(stats.scanlines_rendered, 1);
+  }
+
+  if (renderer.running) {
+    SubmitRenderJob(scanline, oam, oam_line);
+    return;
+  }
+
+  if (scanline) {
+    RenderScanline();
+  }
+
+  if (oam) {
+    RenderLayerOAM(mmio.dispcnt.mode >= 3, oam_line);
+  }
 }
 
 void PPU::CheckVerticalCounterIRQ() {
@@ -79,7 +226,7 @@ void PPU::OnScanlineComplete(int cycles_late) {
   auto& bgpd = mmio.bgpd;
   auto& mosaic = mmio.mosaic;
 
-  scheduler.Add(226 - cycles_late, this, &PPU::OnHblankComplete);
+  scheduler.Add(226 - cycles_late, EventClass::PPU, this, &PPU::OnHblankComplete);
 
   mmio.dispstat.hblank_flag = 1;
 
@@ -144,9 +291,21 @@ void PPU::OnHblankComplete(int cycles_late) {
   }
 
   if (vcount == 160) {
-    config->video_dev->Draw(output);
+    frame_unchanged = !frame_dirty && !frame_dirty_last;
+    frame_dirty_last = frame_dirty;
+    frame_dirty = false;
+
+    if (!renderer.running) {
+      PresentFrame();
+    } else if (renderer.mode == Config::Video::RenderMode::Threaded) {
+      WaitForRenderJobs();
+      PresentFrame();
+    } else {
+      // Render the frame in parallel to V-Blank, it is presented once V-Blank ends.
+      DispatchFrame();
+    }
 
-    scheduler.Add(1006 - cycles_late, this, &PPU::OnVblankScanlineComplete);
+    scheduler.Add(1006 - cycles_late, EventClass::PPU, this, &PPU::OnVblankScanlineComplete);
     dma.Request(DMA::Occasion::VBlank);
     dispstat.vblank_flag = 1;
 
@@ -164,19 +323,16 @@ void PPU::OnHblankComplete(int cycles_late) {
     bgx[1]._current = bgx[1].initial;
     bgy[1]._current = bgy[1].initial;
   } else {
-    scheduler.Add(1006 - cycles_late, this, &PPU::OnScanlineComplete);
-    RenderScanline();
-    // Render OBJs for the *next* scanline.
-    if (mmio.dispcnt.enable[ENABLE_OBJ]) {
-      RenderLayerOAM(mmio.dispcnt.mode >= 3, mmio.vcount + 1);
-    }
+    scheduler.Add(1006 - cycles_late, EventClass::PPU, this, &PPU::OnScanlineComplete);
+    // Render this scanline and the OBJs for the *next* scanline.
+    Render(true, mmio.dispcnt.enable[ENABLE_OBJ], mmio.vcount + 1);
   }
 }
 
 void PPU::OnVblankScanlineComplete(int cycles_late) {
   auto& dispstat = mmio.dispstat;
 
-  scheduler.Add(226 - cycles_late, this, &PPU::OnVblankHblankComplete);
+  scheduler.Add(226 - cycles_late, EventClass::PPU, this, &PPU::OnVblankHblankComplete);
 
   dispstat.hblank_flag = 1;
 
@@ -198,16 +354,18 @@ void PPU::OnVblankHblankComplete(int cycles_late) {
   dispstat.hblank_flag = 0;
 
   if (vcount == 227) {
-    scheduler.Add(1006 - cycles_late, this, &PPU::OnScanlineComplete);
+    scheduler.Add(1006 - cycles_late, EventClass::PPU, this, &PPU::OnScanlineComplete);
     vcount = 0;
   } else {
-    scheduler.Add(1006 - cycles_late, this, &PPU::OnVblankScanlineComplete);
+    scheduler.Add(1006 - cycles_late, EventClass::PPU, this, &PPU::OnVblankScanlineComplete);
     if (++vcount == 227) {
       dispstat.vblank_flag = 0;
-      // Render OBJs for the *next* scanline
-      if (mmio.dispcnt.enable[ENABLE_OBJ]) {
-        RenderLayerOAM(mmio.dispcnt.mode >= 3, 0);
+      if (renderer.running && renderer.frame_pending) {
+        CompleteFrame();
+        PresentFrame();
       }
+      // Render OBJs for the *next* scanline
+      Render(false, mmio.dispcnt.enable[ENABLE_OBJ], 0);
     }
   }
 
@@ -220,7 +378,7 @@ void PPU::OnVblankHblankComplete(int cycles_late) {
   }
 
   if (vcount == 0) {
-    RenderScanline();
+    Render(true, false, 0);
   }
 
   CheckVerticalCounterIRQ();
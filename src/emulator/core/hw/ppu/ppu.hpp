@@ -11,23 +11,73 @@
 #include <emulator/core/hw/dma.hpp>
 #include <emulator/core/hw/interrupt.hpp>
 #include <emulator/core/scheduler.hpp>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "registers.hpp"
 
 namespace nba::core {
 
+struct BootSnapshot;
+
 class PPU {
 public:
-  PPU(Scheduler& scheduler, IRQ& irq, DMA& dma, std::shared_ptr<Config> config);
+  PPU(Scheduler& scheduler, IRQ& irq, DMA& dma, Stats& stats, std::shared_ptr<Config> config);
+ ~PPU();
 
   void Reset();
 
+  // Resets the emulated state only, running render threads are reused.
+  void SoftReset();
+
+  // LoadState() must be called after a reset, at the timestamp of the snapshot.
+  void CopyState(BootSnapshot& snapshot) const;
+  void LoadState(BootSnapshot const& snapshot);
+
   std::uint8_t pram[0x00400];
   std::uint8_t oam [0x00400];
   std::uint8_t vram[0x18000];
 
+  template<typename T>
+  void WritePRAM(std::uint32_t address, T value) {
+    WriteMemory<T>(Memory::PRAM, pram, address, value);
+  }
+
+  template<typename T>
+  void WriteOAM(std::uint32_t address, T value) {
+    WriteMemory<T>(Memory::OAM, oam, address, value);
+  }
+
+  template<typename T>
+  void WriteVRAM(std::uint32_t address, T value) {
+    WriteMemory<T>(Memory::VRAM, vram, address, value);
+  }
+
+  // Block writes, which behave like writing count (half)words one after another.
+  template<typename T>
+  void WritePRAMBlock(std::uint32_t address, std::uint8_t const* data, int count) {
+    WriteMemoryBlock<T>(Memory::PRAM, pram, address, data, count);
+  }
+
+  template<typename T>
+  void WriteOAMBlock(std::uint32_t address, std::uint8_t const* data, int count) {
+    WriteMemoryBlock<T>(Memory::OAM, oam, address, data, count);
+  }
+
+  template<typename T>
+  void WriteVRAMBlock(std::uint32_t address, std::uint8_t const* data, int count) {
+    WriteMemoryBlock<T>(Memory::VRAM, vram, address, data, count);
+  }
+
+  // Must be called before a PPU register is written.
+  void OnRegisterWrite(std::uint32_t address, std::uint8_t value);
+
   struct MMIO {
     DisplayControl dispcnt;
     DisplayStatus dispstat;
@@ -61,6 +111,73 @@ public:
 private:
   friend struct DisplayStatus;
 
+  enum class Memory : std::uint8_t {
+    PRAM,
+    OAM,
+    VRAM
+  };
+
+  struct MemoryWrite {
+    Memory memory;
+    std::uint8_t size;
+    std::uint32_t address;
+    std::uint32_t value;
+  };
+
+  /* Everything the renderer needs to reproduce a scanline
+   * on another thread, captured at the time the line would have been drawn.
+   */
+  struct RenderJob {
+    MMIO mmio;
+    bool buffer_win[2][240];
+    bool window_scanline_enable[2];
+    bool render_scanline;
+    bool render_oam;
+    int oam_line;
+    std::vector<MemoryWrite> writes;
+  };
+
+  PPU(PPU const& parent);
+
+  template<typename T>
+  void WriteMemory(Memory memory, std::uint8_t* buffer, std::uint32_t address, T value) {
+    if (std::memcmp(&buffer[address], &value, sizeof(T)) == 0) {
+      return;
+    }
+    MarkFrameDirty();
+    std::memcpy(&buffer[address], &value, sizeof(T));
+    if (memory == Memory::OAM && (address & 7) < 4) {
+      oam_dirty = true;
+    }
+    if (renderer.running) {
+      renderer.write_log->push_back({ memory, sizeof(T), address, value });
+    }
+  }
+
+  template<typename T>
+  void WriteMemoryBlock(Memory memory, std::uint8_t* buffer, std::uint32_t address, std::uint8_t const* data, int count) {
+    auto size = count * sizeof(T);
+
+    // The render threads replay each write individually.
+    if (renderer.running) {
+      for (int i = 0; i < count; i++) {
+        T value;
+        std::memcpy(&value, &data[i * sizeof(T)], sizeof(T));
+        WriteMemory<T>(memory, buffer, address + i * sizeof(T), value);
+      }
+      return;
+    }
+
+    if (std::memcmp(&buffer[address], data, size) == 0) {
+      return;
+    }
+    MarkFrameDirty();
+    std::memcpy(&buffer[address], data, size);
+    if (memory == Memory::OAM) {
+      oam_dirty = true;
+    }
+  }
+
   enum ObjAttribute {
     OBJ_IS_ALPHA  = 1,
     OBJ_IS_WINDOW = 2
@@ -100,16 +217,43 @@ private:
   void OnVblankScanlineComplete(int cycles_late);
   void OnVblankHblankComplete(int cycles_late);
 
+  void MarkFrameDirty() {
+    if (!frame_dirty) {
+      OnFrameDirty();
+    }
+  }
+
+  void OnFrameDirty();
+  void Render(bool scanline, bool oam, int oam_line);
+  void StartRenderThreads();
+  void StopRenderThreads();
+  void ResetState();
+  void CopyRenderState(PPU const& parent);
+  void DiscardRenderJobs();
+  void SubmitRenderJob(bool scanline, bool oam, int oam_line);
+  void WaitForRenderJobs();
+  void DispatchFrame();
+  void CompleteFrame();
+  void RenderThreadMain();
+  void StripeThreadMain(int id);
+  void RunStripe(int id, int begin, int end);
+  void RunRenderJob(PPU& ppu, RenderJob const& job, bool scanline, bool oam);
+
   void RenderScanline();
   void RenderLayerText(int id);
   void RenderLayerAffine(int id);
   void RenderLayerBitmap1();
   void RenderLayerBitmap2();
   void RenderLayerBitmap3();
+  auto RenderBitmapDirect() -> bool;
   void RenderLayerOAM(bool bitmap_mode, int line);
+  void UpdateObjectList();
   void RenderWindow(int id);
 
   static auto ConvertColor(std::uint16_t color) -> std::uint32_t;
+  static auto ConvertColorRGB565(std::uint16_t color) -> std::uint16_t;
+  void PresentFrame();
+  auto ConvertFrameIndexed8() -> bool;
 
   template<bool window, bool blending>
   void ComposeScanlineTmpl(int bg_min, int bg_max);
@@ -121,6 +265,7 @@ private:
   Scheduler& scheduler;
   IRQ& irq;
   DMA& dma;
+  Stats& stats;
   std::shared_ptr<Config> config;
 
   std::uint16_t buffer_bg[4][240];
@@ -134,12 +279,68 @@ private:
     unsigned window : 1;
   } buffer_obj[240];
 
+  /* For each scanline the OAM entries which cover it, in OAM order.
+   * Rebuilt when attribute 0 or 1 of any OAM entry has been written.
+   */
+  bool oam_dirty;
+  int obj_list_size[161];
+  std::uint8_t obj_list[161][128];
+
   bool buffer_win[2][240];
   bool window_scanline_enable[2];
 
-  std::uint32_t output[240*160];
+  /* Rendering is skipped while nothing that affects the image has changed
+   * during both the current and the previous frame, the output then still holds the same image.
+   * The OBJ line that would have been rendered last is rendered once something changes.
+   */
+  bool frame_dirty;
+  bool frame_dirty_last;
+  bool frame_unchanged;
+  std::uint16_t register_value[0x56];
+
+  struct SkippedOAM {
+    bool pending;
+    int line;
+    int mosaic_y;
+  } skipped_oam;
+
+  // Native BGR555 output, converted to the configured pixel format in PresentFrame().
+  std::uint16_t output[240*160];
+
+  std::unique_ptr<std::uint8_t[]> frame_data;
+  std::unique_ptr<std::int16_t[]> frame_color_index;
+  std::uint16_t frame_palette[256];
+  int frame_palette_size;
+  FrameBuffer frame {};
+
+  struct RenderWorker {
+    std::unique_ptr<PPU> ppu;
+    std::thread thread;
+  };
+
+  struct Renderer {
+    bool running = false;
+    bool quit;
+    Config::Video::RenderMode mode;
+    std::vector<RenderWorker> workers;
+    std::mutex mutex;
+    std::condition_variable cv_submit;
+    std::condition_variable cv_complete;
+    std::vector<RenderJob> jobs;
+    std::vector<MemoryWrite>* write_log;
+    int head;
+    int tail;
+
+    // Stripe rendering: the jobs of the frame which is currently being rendered.
+    bool frame_pending;
+    int frame_id;
+    int frame_begin;
+    int frame_end;
+    int stripes_done;
+  } renderer;
 
   static constexpr std::uint16_t s_color_transparent = 0x8000;
+  static constexpr int s_render_job_count = 256;
   static const int s_obj_size[4][4][2];
 };
 
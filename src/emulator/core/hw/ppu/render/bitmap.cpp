@@ -37,4 +37,65 @@ void PPU::RenderLayerBitmap3() {
   });
 }
 
+/* Fast path for the common case of a bitmap being displayed as-is:
+ * only BG2 is enabled, no windows, blending, mosaic or scaling and rotation.
+ * VRAM rows are then copied straight to the output, bypassing the compositor.
+ */
+auto PPU::RenderBitmapDirect() -> bool {
+  auto const& dispcnt = mmio.dispcnt;
+  auto const& bg = mmio.bgcnt[2];
+
+  if (!dispcnt.enable[ENABLE_BG2] ||
+       dispcnt.enable[ENABLE_OBJ] ||
+       dispcnt.enable[ENABLE_WIN0] ||
+       dispcnt.enable[ENABLE_WIN1] ||
+       dispcnt.enable[ENABLE_OBJWIN] ||
+       mmio.bldcnt.sfx != BlendControl::SFX_NONE ||
+       bg.mosaic_enable || mmio.bgpa[0] != 0x100 || mmio.bgpc[0] != 0) {
+    return false;
+  }
+
+  int mode = dispcnt.mode;
+  int width  = (mode == 5) ? 160 : 240;
+  int height = (mode == 5) ? 128 : 160;
+  int ref_x = mmio.bgx[0]._current >> 8;
+  int ref_y = mmio.bgy[0]._current >> 8;
+
+  if (ref_x != 0 || ref_y < 0 || ref_y >= height || (width != 240 && bg.wraparound)) {
+    return false;
+  }
+
+  std::uint16_t* line = &output[mmio.vcount * 240];
+  std::uint16_t backdrop = ReadPalette(0, 0);
+  auto frame = dispcnt.frame * 0xA000;
+
+  switch (mode) {
+    case 3:
+    case 5: {
+      std::uint8_t* data = (mode == 3) ? &vram[ref_y * 480] : &vram[frame + ref_y * 320];
+
+      for (int x = 0; x < width; x++) {
+        std::uint16_t color = (data[x * 2 + 1] << 8) | data[x * 2];
+
+        line[x] = (color == s_color_transparent) ? backdrop : (color & 0x7FFF);
+      }
+
+      for (int x = width; x < 240; x++) {
+        line[x] = backdrop;
+      }
+      break;
+    }
+    case 4: {
+      std::uint8_t* data = &vram[frame + ref_y * 240];
+
+      for (int x = 0; x < 240; x++) {
+        line[x] = ReadPalette(0, data[x]);
+      }
+      break;
+    }
+  }
+
+  return true;
+}
+
 } // namespace nba::core
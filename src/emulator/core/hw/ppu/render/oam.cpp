@@ -5,6 +5,8 @@
  * Refer to the included LICENSE file.
  */
 
+#include <algorithm>
+
 #include "../ppu.hpp"
 
 namespace nba::core {
@@ -40,6 +42,51 @@ const int PPU::s_obj_size[4][4][2] = {
   }
 };
 
+void PPU::UpdateObjectList() {
+  for (int line = 0; line <= 160; line++) {
+    obj_list_size[line] = 0;
+  }
+
+  for (int index = 0; index < 128; index++) {
+    int offset = index * 8;
+
+    if ((oam[offset + 1] & 3) == 2) continue;
+
+    std::uint16_t attr0 = (oam[offset + 1] << 8) | oam[offset + 0];
+    std::uint16_t attr1 = (oam[offset + 3] << 8) | oam[offset + 2];
+
+    std::int32_t y = attr0 & 0x0FF;
+    int shape = attr0 >> 14;
+    int size  = attr1 >> 14;
+    int mode  = (attr0 >> 10) & 3;
+
+    if (mode == OBJ_PROHIBITED) {
+      continue;
+    }
+
+    if (y >= 160) y -= 256;
+
+    int half_height = s_obj_size[shape][size][1] / 2;
+
+    y += half_height;
+
+    // Affine double-size OBJs cover twice the height.
+    if ((attr0 & 0x300) == 0x300) {
+      y += half_height;
+      half_height *= 2;
+    }
+
+    int line_min = std::max(y - half_height, 0);
+    int line_max = std::min(y + half_height, 161);
+
+    for (int line = line_min; line < line_max; line++) {
+      obj_list[line][obj_list_size[line]++] = index;
+    }
+  }
+
+  oam_dirty = false;
+}
+
 void PPU::RenderLayerOAM(bool bitmap_mode, int line) {
   std::int16_t transform[4];
 
@@ -58,8 +105,13 @@ void PPU::RenderLayerOAM(bool bitmap_mode, int line) {
     buffer_obj[x].window = 0;
   }
 
-  for (std::int32_t offset = 0; offset <= 127 * 8; offset += 8) {
-    if ((oam[offset + 1] & 3) == 2) continue;
+  if (oam_dirty) {
+    UpdateObjectList();
+  }
+
+  // Only OBJs that cover this scanline are considered, they do not take up any cycles otherwise.
+  for (int i = 0; i < obj_list_size[line]; i++) {
+    std::int32_t offset = obj_list[line][i] * 8;
 
     std::uint16_t attr0 = (oam[offset + 1] << 8) | oam[offset + 0];
     std::uint16_t attr1 = (oam[offset + 3] << 8) | oam[offset + 2];
@@ -76,10 +128,6 @@ void PPU::RenderLayerOAM(bool bitmap_mode, int line) {
     int mode   = (attr0 >> 10) & 3;
     int mosaic = (attr0 >> 12) & 1;
 
-    if (mode == OBJ_PROHIBITED) {
-      continue;
-    }
-
     if (x >= 240) x -= 512;
     if (y >= 160) y -= 256;
 
@@ -122,10 +170,6 @@ void PPU::RenderLayerOAM(bool bitmap_mode, int line) {
       cycles_per_pixel = 1;
     }
 
-    if (line < (y - half_height) || line >= (y + half_height)) {
-      continue;
-    }
-
     int local_y = line - y;
     int number  =  attr2 & 0x3FF;
     int palette = (attr2 >> 12) + 16;
@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2020 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <algorithm>
+
+#include "ppu.hpp"
+
+namespace nba::core {
+
+/* Creates a copy of the PPU which is used solely for rendering on a render thread.
+ * It does not schedule any events and is only ever driven through RunRenderJob().
+ */
+PPU::PPU(PPU const& parent)
+    : scheduler(parent.scheduler)
+    , irq(parent.irq)
+    , dma(parent.dma)
+    , stats(parent.stats)
+    , config(parent.config) {
+  CopyRenderState(parent);
+}
+
+void PPU::CopyRenderState(PPU const& parent) {
+  std::memcpy(pram, parent.pram, sizeof(pram));
+  std::memcpy(oam,  parent.oam,  sizeof(oam));
+  std::memcpy(vram, parent.vram, sizeof(vram));
+  std::memcpy(buffer_bg, parent.buffer_bg, sizeof(buffer_bg));
+  std::memcpy(buffer_obj, parent.buffer_obj, sizeof(buffer_obj));
+  line_contains_alpha_obj = parent.line_contains_alpha_obj;
+  oam_dirty = true;
+  mmio = parent.mmio;
+}
+
+void PPU::StartRenderThreads() {
+  using RenderMode = Config::Video::RenderMode;
+
+  int count = 1;
+
+  renderer.mode = config->video.render_mode;
+  if (renderer.mode == RenderMode::Stripes) {
+    count = std::clamp(config->video.render_stripes, 1, 32);
+  }
+
+  renderer.jobs.resize(s_render_job_count);
+  renderer.head = 0;
+  renderer.tail = 0;
+  renderer.write_log = &renderer.jobs[0].writes;
+  renderer.quit = false;
+  renderer.frame_pending = false;
+  renderer.frame_id = 0;
+  renderer.running = true;
+
+  renderer.workers.resize(count);
+
+  for (int id = 0; id < count; id++) {
+    auto& worker = renderer.workers[id];
+
+    worker.ppu = std::unique_ptr<PPU>{new PPU{*this}};
+    if (renderer.mode == RenderMode::Stripes) {
+      worker.thread = std::thread{&PPU::StripeThreadMain, this, id};
+    } else {
+      worker.thread = std::thread{&PPU::RenderThreadMain, this};
+    }
+  }
+}
+
+void PPU::StopRenderThreads() {
+  if (!renderer.running) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(renderer.mutex);
+    renderer.quit = true;
+  }
+  renderer.cv_submit.notify_all();
+
+  for (auto& worker : renderer.workers) {
+    worker.thread.join();
+  }
+
+  for (auto& job : renderer.jobs) {
+    job.writes.clear();
+  }
+
+  renderer.workers.clear();
+  renderer.running = false;
+}
+
+/* Waits until the render threads are idle and drops the jobs which have not been dispatched yet.
+ * Used when the PPU is reset while the render threads keep running.
+ */
+void PPU::DiscardRenderJobs() {
+  if (renderer.mode == Config::Video::RenderMode::Threaded) {
+    WaitForRenderJobs();
+  } else if (renderer.frame_pending) {
+    CompleteFrame();
+  }
+
+  std::lock_guard<std::mutex> guard(renderer.mutex);
+
+  for (int i = renderer.tail; i <= renderer.head; i++) {
+    renderer.jobs[i % s_render_job_count].writes.clear();
+  }
+  renderer.tail = renderer.head;
+}
+
+void PPU::SubmitRenderJob(bool scanline, bool oam, int oam_line) {
+  auto& job = renderer.jobs[renderer.head % s_render_job_count];
+
+  job.mmio = mmio;
+  std::copy_n(&buffer_win[0][0], 2 * 240, &job.buffer_win[0][0]);
+  job.window_scanline_enable[0] = window_scanline_enable[0];
+  job.window_scanline_enable[1] = window_scanline_enable[1];
+  job.render_scanline = scanline;
+  job.render_oam = oam;
+  job.oam_line = oam_line;
+
+  std::unique_lock<std::mutex> lock(renderer.mutex);
+
+  renderer.head++;
+
+  if (renderer.mode == Config::Video::RenderMode::Threaded) {
+    renderer.cv_submit.notify_one();
+  }
+
+  // The slot that receives subsequent memory writes must not be in use by a render thread.
+  renderer.cv_complete.wait(lock, [this] {
+    return renderer.head - renderer.tail < s_render_job_count;
+  });
+
+  renderer.write_log = &renderer.jobs[renderer.head % s_render_job_count].writes;
+}
+
+void PPU::WaitForRenderJobs() {
+  std::unique_lock<std::mutex> lock(renderer.mutex);
+
+  renderer.cv_complete.wait(lock, [this] {
+    return renderer.tail == renderer.head;
+  });
+}
+
+void PPU::DispatchFrame() {
+  {
+    std::lock_guard<std::mutex> guard(renderer.mutex);
+    renderer.frame_pending = true;
+    renderer.frame_id++;
+    renderer.frame_begin = renderer.tail;
+    renderer.frame_end = renderer.head;
+    renderer.stripes_done = 0;
+  }
+  renderer.cv_submit.notify_all();
+}
+
+void PPU::CompleteFrame() {
+  std::unique_lock<std::mutex> lock(renderer.mutex);
+
+  renderer.cv_complete.wait(lock, [this] {
+    return renderer.stripes_done == (int)renderer.workers.size();
+  });
+
+  for (int i = renderer.frame_begin; i < renderer.frame_end; i++) {
+    renderer.jobs[i % s_render_job_count].writes.clear();
+  }
+
+  renderer.tail = renderer.frame_end;
+  renderer.frame_pending = false;
+
+  /* The last stripe ends with the OBJ buffer as it was left by the frame.
+   * Keep it around since the next frame may start out with it.
+   */
+  auto& last = *renderer.workers.back().ppu;
+  std::memcpy(buffer_obj, last.buffer_obj, sizeof(buffer_obj));
+  line_contains_alpha_obj = last.line_contains_alpha_obj;
+}
+
+void PPU::RenderThreadMain() {
+  auto& ppu = *renderer.workers[0].ppu;
+
+  std::unique_lock<std::mutex> lock(renderer.mutex);
+
+  while (true) {
+    renderer.cv_submit.wait(lock, [this] {
+      return renderer.quit || renderer.tail != renderer.head;
+    });
+
+    if (renderer.tail == renderer.head) {
+      return;
+    }
+
+    auto& job = renderer.jobs[renderer.tail % s_render_job_count];
+
+    lock.unlock();
+    RunRenderJob(ppu, job, job.render_scanline, job.render_oam);
+    job.writes.clear();
+    lock.lock();
+
+    renderer.tail++;
+    renderer.cv_complete.notify_one();
+  }
+}
+
+void PPU::StripeThreadMain(int id) {
+  int frame_id = 0;
+
+  std::unique_lock<std::mutex> lock(renderer.mutex);
+
+  while (true) {
+    renderer.cv_submit.wait(lock, [&] {
+      return renderer.quit || renderer.frame_id != frame_id;
+    });
+
+    if (renderer.frame_id == frame_id) {
+      return;
+    }
+
+    frame_id = renderer.frame_id;
+
+    int begin = renderer.frame_begin;
+    int end = renderer.frame_end;
+
+    lock.unlock();
+    RunStripe(id, begin, end);
+    lock.lock();
+
+    if (++renderer.stripes_done == (int)renderer.workers.size()) {
+      renderer.cv_complete.notify_one();
+    }
+  }
+}
+
+void PPU::RunStripe(int id, int begin, int end) {
+  auto& ppu = *renderer.workers[id].ppu;
+  int count = end - begin;
+  int stripes = renderer.workers.size();
+  int stripe_begin = begin + count * id / stripes;
+  int stripe_end = begin + count * (id + 1) / stripes;
+
+  /* The first scanline of the stripe displays the OBJs from the last job that rendered OBJs.
+   * If there is no such job in this frame, they are left over from the previous frame.
+   */
+  int oam_job = -1;
+
+  for (int i = stripe_begin - 1; i >= begin; i--) {
+    if (renderer.jobs[i % s_render_job_count].render_oam) {
+      oam_job = i;
+      break;
+    }
+  }
+
+  if (oam_job == -1) {
+    std::memcpy(ppu.buffer_obj, buffer_obj, sizeof(buffer_obj));
+    ppu.line_contains_alpha_obj = line_contains_alpha_obj;
+  }
+
+  // Every stripe replays all memory writes, so that its copy of the memory stays in sync.
+  for (int i = begin; i < end; i++) {
+    auto const& job = renderer.jobs[i % s_render_job_count];
+
+    if (i >= stripe_begin && i < stripe_end) {
+      RunRenderJob(ppu, job, job.render_scanline, job.render_oam);
+    } else if (i == oam_job) {
+      RunRenderJob(ppu, job, false, true);
+    } else {
+      RunRenderJob(ppu, job, false, false);
+    }
+  }
+}
+
+void PPU::RunRenderJob(PPU& ppu, RenderJob const& job, bool scanline, bool oam) {
+  for (auto const& write : job.writes) {
+    std::uint8_t* buffer;
+
+    switch (write.memory) {
+      case Memory::PRAM: buffer = ppu.pram; break;
+      case Memory::OAM:  buffer = ppu.oam;  break;
+      default:           buffer = ppu.vram; break;
+    }
+
+    std::memcpy(&buffer[write.address], &write.value, write.size);
+
+    if (write.memory == Memory::OAM && (write.address & 7) < 4) {
+      ppu.oam_dirty = true;
+    }
+  }
+
+  if (!scanline && !oam) {
+    return;
+  }
+
+  ppu.mmio = job.mmio;
+  std::copy_n(&job.buffer_win[0][0], 2 * 240, &ppu.buffer_win[0][0]);
+  ppu.window_scanline_enable[0] = job.window_scanline_enable[0];
+  ppu.window_scanline_enable[1] = job.window_scanline_enable[1];
+
+  if (scanline) {
+    auto line = job.mmio.vcount * 240;
+
+    ppu.RenderScanline();
+    std::copy_n(&ppu.output[line], 240, &output[line]);
+  }
+
+  if (oam) {
+    ppu.RenderLayerOAM(job.mmio.dispcnt.mode >= 3, job.oam_line);
+  }
+}
+
+} // namespace nba::core
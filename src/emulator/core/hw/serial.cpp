@@ -6,6 +6,7 @@
  */
 
 #include <common/log.hpp>
+#include <emulator/core/boot_snapshot.hpp>
 #include <emulator/core/cpu-mmio.hpp>
 
 #include "serial.hpp"
@@ -96,5 +97,24 @@ void SerialBus::Write(std::uint32_t address, std::uint8_t value) {
   }
 }
 
+void SerialBus::CopyState(BootSnapshot& snapshot) const {
+  snapshot.serial.data32 = data32;
+  snapshot.serial.data8 = data8;
+  snapshot.serial.rcnt = rcnt;
+  snapshot.serial.siocnt = (int(siocnt.clock_source) << 0) |
+                           (int(siocnt.clock_speed)  << 1) |
+                           (siocnt.unused << 8) |
+                           (int(siocnt.width) << 12) |
+                           (siocnt.enable_irq ? 0x4000 : 0);
+}
+
+void SerialBus::LoadState(BootSnapshot const& snapshot) {
+  data32 = snapshot.serial.data32;
+  data8 = snapshot.serial.data8;
+  rcnt = snapshot.serial.rcnt;
+  Write(SIOCNT | 0, snapshot.serial.siocnt & 0xFF);
+  Write(SIOCNT | 1, snapshot.serial.siocnt >> 8);
+}
+
 } // namespace nba::core
 
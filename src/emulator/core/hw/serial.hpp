@@ -13,6 +13,8 @@
 
 namespace nba::core {
 
+struct BootSnapshot;
+
 class SerialBus {
 public:
   SerialBus(IRQ& irq) : irq(irq) {}
@@ -20,6 +22,8 @@ public:
   void Reset();
   auto Read(std::uint32_t address) -> std::uint8_t;
   void Write(std::uint32_t address, std::uint8_t value);
+  void CopyState(BootSnapshot& snapshot) const;
+  void LoadState(BootSnapshot const& snapshot);
 
 private:
   std::uint8_t data8;
@@ -5,7 +5,9 @@
  * Refer to the included LICENSE file.
  */
 
+#include <algorithm>
 #include <common/log.hpp>
+#include <emulator/core/boot_snapshot.hpp>
 
 #include "timer.hpp"
 
@@ -14,6 +16,9 @@ namespace nba::core {
 static constexpr int g_ticks_shift[4] = { 0, 6, 8, 10 };
 static constexpr int g_ticks_mask[4] = { 0, 0x3F, 0xFF, 0x3FF };
 
+// NOTE: upper bound for the time between two events of a channel whose overflows are batched.
+static constexpr std::uint64_t g_max_batch_cycles = 0x1000000;
+
 void Timer::Reset() {
   for (int id = 0; id < 4; id++) {
     auto& channel = channels[id];
@@ -22,30 +27,22 @@ void Timer::Reset() {
     channel.event_cb = [this, id](int cycles_late) {
       // FIXME: ideally we would just capture the existing channel reference... not sure if it is possible.
       auto& channel = channels[id];
-      OnOverflow(channel);
+      channel.event = nullptr;
+      Advance(channel, GetCounterDeltaSinceLastUpdate(channel));
       StartChannel(channel, cycles_late);
     };
   }
 }
 
 auto Timer::Read(int chan_id, int offset) -> std::uint8_t {
-  auto const& channel = channels[chan_id];
-  auto const& control = channel.control;
-
-  auto counter = channel.counter;
-
-  // While the timer is still running we must account for time that has passed
-  // since the last counter update (overflow or configuration change).
-  if (channel.running) {
-    counter += GetCounterDeltaSinceLastUpdate(channel);
-  }
+  auto const& control = channels[chan_id].control;
 
   switch (offset) {
     case REG_TMXCNT_L | 0: {
-      return counter & 0xFF;
+      return GetCounter(chan_id) & 0xFF;
     }
     case REG_TMXCNT_L | 1: {
-      return counter >> 8;
+      return GetCounter(chan_id) >> 8;
     }
     case REG_TMXCNT_H: {
       return (control.frequency) |
@@ -57,16 +54,28 @@ auto Timer::Read(int chan_id, int offset) -> std::uint8_t {
   }
 }
 
+auto Timer::ReadHalf(int chan_id, int offset) -> std::uint16_t {
+  if (offset == REG_TMXCNT_L) {
+    return GetCounter(chan_id);
+  }
+  return Read(chan_id, offset);
+}
+
 void Timer::Write(int chan_id, int offset, std::uint8_t value) {
   auto& channel = channels[chan_id];
   auto& control = channel.control;
 
   switch (offset) {
-    case REG_TMXCNT_L | 0: channel.reload = (channel.reload & 0xFF00) | (value << 0); break;
-    case REG_TMXCNT_L | 1: channel.reload = (channel.reload & 0x00FF) | (value << 8); break;
+    case REG_TMXCNT_L | 0: WriteReload(chan_id, (channel.reload & 0xFF00) | (value << 0)); break;
+    case REG_TMXCNT_L | 1: WriteReload(chan_id, (channel.reload & 0x00FF) | (value << 8)); break;
     case REG_TMXCNT_H: {
       bool enable_previous = control.enable;
 
+      // The previous channel batches its overflows based on the configuration of this channel.
+      if (chan_id != 0) {
+        Reschedule(chan_id - 1);
+      }
+
       if (channel.running) {
         StopChannel(channel);
       }
@@ -94,9 +103,57 @@ void Timer::Write(int chan_id, int offset, std::uint8_t value) {
           StartChannel(channel, late);
         }
       }
+
+      if (chan_id != 0) {
+        Reschedule(chan_id - 1);
+      }
     }
   }
 
+  UpdateSampleRates(chan_id);
+}
+
+void Timer::WriteHalf(int chan_id, int offset, std::uint16_t value) {
+  switch (offset) {
+    case REG_TMXCNT_L:
+      WriteReload(chan_id, value);
+      UpdateSampleRates(chan_id);
+      break;
+    case REG_TMXCNT_H:
+      Write(chan_id, REG_TMXCNT_H, value & 0xFF);
+      break;
+  }
+}
+
+void Timer::CopyState(BootSnapshot& snapshot) {
+  for (int id = 0; id < 4; id++) {
+    auto& state = snapshot.timer[id];
+
+    state.reload = channels[id].reload;
+    state.counter = GetCounter(id);
+    state.control = Read(id, REG_TMXCNT_H);
+  }
+}
+
+// A snapshot is never taken while a timer is running, however cascading timers may be enabled.
+void Timer::LoadState(BootSnapshot const& snapshot) {
+  for (int id = 0; id < 4; id++) {
+    auto const& state = snapshot.timer[id];
+
+    WriteReload(id, state.reload);
+    Write(id, REG_TMXCNT_H, state.control);
+    channels[id].counter = state.counter;
+  }
+}
+
+void Timer::WriteReload(int chan_id, std::uint16_t value) {
+  // Overflows which have been batched must be handled using the old reload value.
+  Reschedule(chan_id);
+  channels[chan_id].reload = value;
+  Reschedule(chan_id);
+}
+
+void Timer::UpdateSampleRates(int chan_id) {
   if (chan_id <= 1) {
     constexpr int kCyclesPerSecond = 16777216;
     auto timer0_duty = 0x10000 - channels[0].reload;
@@ -110,29 +167,120 @@ void Timer::Write(int chan_id, int offset, std::uint8_t value) {
   }
 }
 
-auto Timer::GetCounterDeltaSinceLastUpdate(Channel const& channel) -> std::uint32_t {
-  return (scheduler.GetTimestampNow() - channel.timestamp_started) >> channel.shift;
+void Timer::Reschedule(int chan_id) {
+  auto& channel = channels[chan_id];
+
+  if (channel.running) {
+    auto elapsed = std::int64_t(scheduler.GetTimestampNow() - channel.timestamp_started);
+    int late = elapsed < 0 ? int(elapsed) : int(elapsed & channel.mask);
+
+    StopChannel(channel);
+    StartChannel(channel, late);
+  }
+}
+
+auto Timer::GetCounter(int chan_id) -> std::uint16_t {
+  auto const& channel = channels[chan_id];
+  auto const& control = channel.control;
+
+  std::uint64_t counter = channel.counter;
+
+  // While the timer is still running we must account for time that has passed
+  // since the last counter update (overflow or configuration change).
+  // Cascading channels may have yet to count overflows which the previous channel handles in bulk.
+  if (channel.running) {
+    counter += GetCounterDeltaSinceLastUpdate(channel);
+  } else if (control.enable && control.cascade) {
+    counter += GetPendingOverflows(channels[chan_id - 1]);
+  }
+
+  if (counter >= 0x10000) {
+    counter = channel.reload + (counter - 0x10000) % (0x10000 - channel.reload);
+  }
+  return counter;
+}
+
+auto Timer::GetCounterDeltaSinceLastUpdate(Channel const& channel) -> std::uint64_t {
+  auto now = scheduler.GetTimestampNow();
+
+  // The channel might still be starting up.
+  if (now < channel.timestamp_started) {
+    return 0;
+  }
+  return (now - channel.timestamp_started) >> channel.shift;
+}
+
+// Returns the number of overflows of a running channel which have not been handled yet.
+auto Timer::GetPendingOverflows(Channel const& channel) -> std::uint32_t {
+  if (!channel.running) {
+    return 0;
+  }
+
+  auto counter = channel.counter + GetCounterDeltaSinceLastUpdate(channel);
+
+  if (counter < 0x10000) {
+    return 0;
+  }
+  return 1 + (counter - 0x10000) / (0x10000 - channel.reload);
+}
+
+/* Returns how many overflows can be handled by a single event.
+ * Only the overflows which raise an IRQ, feed a FIFO or overflow the next channel are observable,
+ * everything in between is handled in bulk.
+ */
+auto Timer::GetOverflowsPerEvent(Channel const& channel) -> std::uint64_t {
+  if (channel.control.interrupt || (channel.id <= 1 && apu.IsFIFOTimer(channel.id))) {
+    return 1;
+  }
+
+  std::uint64_t period = std::uint64_t(0x10000 - channel.reload) << channel.shift;
+  std::uint64_t overflows = std::max<std::uint64_t>(g_max_batch_cycles / period, 1);
+
+  if (channel.id != 3) {
+    auto const& next_channel = channels[channel.id + 1];
+    if (next_channel.control.enable && next_channel.control.cascade) {
+      overflows = std::min<std::uint64_t>(overflows, 0x10000 - next_channel.counter);
+    }
+  }
+
+  return overflows;
 }
 
 void Timer::StartChannel(Channel& channel, int cycles_late) {
-  int cycles = int((0x10000 - channel.counter) << channel.shift);
+  auto overflows = GetOverflowsPerEvent(channel);
+  auto cycles = std::uint64_t(0x10000 - channel.counter + (overflows - 1) * (0x10000 - channel.reload)) << channel.shift;
 
   channel.running = true;
   channel.timestamp_started = scheduler.GetTimestampNow() - cycles_late;
-  channel.event = scheduler.Add(cycles - cycles_late, channel.event_cb);
+  channel.event = scheduler.Add(cycles - cycles_late, EventClass::Timer, channel.event_cb);
 }
 
 void Timer::StopChannel(Channel& channel) {
-  channel.counter += GetCounterDeltaSinceLastUpdate(channel);
-  if (channel.counter >= 0x10000) {
-    OnOverflow(channel);
+  Advance(channel, GetCounterDeltaSinceLastUpdate(channel));
+  if (channel.event != nullptr) {
+    scheduler.Cancel(channel.event);
+    channel.event = nullptr;
   }
-  scheduler.Cancel(channel.event);
-  channel.event = nullptr;
   channel.running = false;
 }
 
-void Timer::OnOverflow(Channel& channel) {
+// Advances the counter by the given number of ticks and handles all overflows that occur on the way.
+void Timer::Advance(Channel& channel, std::uint64_t ticks) {
+  auto counter = channel.counter + ticks;
+
+  if (counter < 0x10000) {
+    channel.counter = counter;
+    return;
+  }
+
+  auto period = 0x10000 - channel.reload;
+  auto excess = counter - 0x10000;
+
+  OnOverflow(channel, int(1 + excess / period));
+  channel.counter += excess % period;
+}
+
+void Timer::OnOverflow(Channel& channel, int times) {
   channel.counter = channel.reload;
 
   if (channel.control.interrupt) {
@@ -140,13 +288,13 @@ void Timer::OnOverflow(Channel& channel) {
   }
 
   if (channel.id <= 1) {
-    apu.OnTimerOverflow(channel.id, 1, channel.samplerate);
+    apu.OnTimerOverflow(channel.id, times, channel.samplerate);
   }
 
   if (channel.id != 3) {
     auto& next_channel = channels[channel.id + 1];
-    if (next_channel.control.enable && next_channel.control.cascade && ++next_channel.counter == 0x10000) {
-      OnOverflow(next_channel);
+    if (next_channel.control.enable && next_channel.control.cascade) {
+      Advance(next_channel, times);
     }
   }
 }
@@ -15,6 +15,8 @@
 
 namespace nba::core {
 
+struct BootSnapshot;
+
 class Timer {
 public:
   Timer(Scheduler& scheduler, IRQ& irq, APU& apu)
@@ -27,6 +29,15 @@ public:
   void Reset();
   auto Read (int chan_id, int offset) -> std::uint8_t;
   void Write(int chan_id, int offset, std::uint8_t value);
+  auto ReadHalf (int chan_id, int offset) -> std::uint16_t;
+  void WriteHalf(int chan_id, int offset, std::uint16_t value);
+  void CopyState(BootSnapshot& snapshot);
+  void LoadState(BootSnapshot const& snapshot);
+
+  /* Brings the channel up to date and reschedules its next event.
+   * Must be called before and after changes that affect whether its overflows are observable.
+   */
+  void Reschedule(int chan_id);
 
 private:
   enum Registers {
@@ -59,10 +70,16 @@ private:
   IRQ& irq;
   APU& apu;
 
-  auto GetCounterDeltaSinceLastUpdate(Channel const& channel) -> std::uint32_t;
+  void WriteReload(int chan_id, std::uint16_t value);
+  void UpdateSampleRates(int chan_id);
+  auto GetCounter(int chan_id) -> std::uint16_t;
+  auto GetCounterDeltaSinceLastUpdate(Channel const& channel) -> std::uint64_t;
+  auto GetPendingOverflows(Channel const& channel) -> std::uint32_t;
+  auto GetOverflowsPerEvent(Channel const& channel) -> std::uint64_t;
   void StartChannel(Channel& channel, int cycles_late);
   void StopChannel(Channel& channel);
-  void OnOverflow(Channel& channel);
+  void Advance(Channel& channel, std::uint64_t ticks);
+  void OnOverflow(Channel& channel, int times);
 };
 
 } // namespace nba::core
@@ -12,6 +12,8 @@
 #include <cstdint>
 #include <functional>
 
+#include "stats.hpp"
+
 namespace nba::core {
 
 class Scheduler {
@@ -24,10 +26,11 @@ public:
   private:
     friend class Scheduler;
     int handle;
+    EventClass type;
     std::uint64_t timestamp;
   };
 
-  Scheduler() {
+  Scheduler(Stats& stats) : stats(stats) {
     for (int i = 0; i < kMaxEvents; i++) {
       heap[i] = new Event();
       heap[i]->handle = i;
@@ -41,9 +44,9 @@ public:
     }
   }
 
-  void Reset() {
+  void Reset(std::uint64_t timestamp = 0) {
     heap_size = 0;
-    timestamp_now = 0;
+    timestamp_now = timestamp;
   }
 
   auto GetTimestampNow() const -> std::uint64_t {
@@ -55,6 +58,10 @@ public:
     return heap[0]->timestamp;
   }
 
+  auto GetEventCount() const -> int {
+    return heap_size;
+  }
+
   auto GetRemainingCycleCount() const -> int {
     return int(GetTimestampTarget() - GetTimestampNow());
   }
@@ -65,7 +72,7 @@ public:
     timestamp_now = timestamp_next;
   }
 
-  auto Add(std::uint64_t delay, std::function<void(int)> callback) -> Event* {
+  auto Add(std::uint64_t delay, EventClass type, std::function<void(int)> callback) -> Event* {
     int n = heap_size++;
     int p = Parent(n);
 
@@ -73,6 +80,7 @@ public:
 
     auto event = heap[n];
     event->timestamp = GetTimestampNow() + delay;
+    event->type = type;
     event->callback = callback;
 
     while (n != 0 && heap[p]->timestamp > heap[n]->timestamp) {
@@ -85,8 +93,8 @@ public:
   }
 
   template<class T>
-  void Add(std::uint64_t delay, T* object, EventMethod<T> method) {
-    Add(delay, [object, method](int cycles_late) {
+  void Add(std::uint64_t delay, EventClass type, T* object, EventMethod<T> method) {
+    Add(delay, type, [object, method](int cycles_late) {
       (object->*method)(cycles_late);
     });
   }
@@ -106,6 +114,7 @@ private:
     while (heap[0]->timestamp <= timestamp_next && heap_size > 0) {
       auto event = heap[0];
       timestamp_now = event->timestamp;
+      NBA_STATS_ADD(stats.events[int(event->type)], 1);
       event->callback(0);
       // NOTE: we cannot just pass zero because the callback may mess with the event queue.
       Remove(event->handle);
@@ -153,6 +162,7 @@ private:
   Event* heap[kMaxEvents];
   int heap_size;
   std::uint64_t timestamp_now;
+  Stats& stats;
 };
 
 } // namespace nba::core
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2020 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/* Profiling counters are only updated when building with NBA_STATS, otherwise all counters stay at zero.
+ * The expression is not evaluated then, but still compiled, so that both builds are kept in sync.
+ */
+#ifdef NBA_STATS
+  #define NBA_STATS_ADD(counter, value) ((counter) += (value))
+#else
+  #define NBA_STATS_ADD(counter, value) ((void)sizeof((counter) += (value)))
+#endif
+
+namespace nba::core {
+
+enum class EventClass {
+  CPU,
+  PPU,
+  APU,
+  IRQ,
+  DMA,
+  Timer,
+  Input,
+  Count
+};
+
+struct Stats {
+  // Indexed by the Thumb bit of the CPSR.
+  std::uint64_t instructions[2] {};
+  std::uint64_t cycles_halted = 0;
+  std::uint64_t dma_cycles[4] {};
+  std::uint64_t events[int(EventClass::Count)] {};
+
+  // Scanlines that were skipped because the frame did not change.
+  std::uint64_t scanlines_rendered = 0;
+  std::uint64_t scanlines_skipped = 0;
+
+  // Indexed by the offset of the halfword register, i.e. (address & 0x3FF) >> 1.
+  std::uint64_t mmio_reads[0x200] {};
+  std::uint64_t mmio_writes[0x200] {};
+
+  std::uint64_t prefetch_hits = 0;
+  std::uint64_t prefetch_misses = 0;
+};
+
+} // namespace nba::core
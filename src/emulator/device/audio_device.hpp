@@ -21,6 +21,12 @@ public:
   virtual auto GetBlockSize() -> int = 0;
   virtual bool Open(void* userdata, Callback callback) = 0;
   virtual void Close() = 0;
+
+  /* Called at the end of each Emulator::Run() and Emulator::Frame() and whenever the audio buffer is half full,
+   * with the number of samples that can be pulled through the callback.
+   * Real-time devices instead pull samples from their own thread, whenever they need them.
+   */
+  virtual void Synchronize(int samples_available) {}
 };
 
 class NullAudioDevice : public AudioDevice {
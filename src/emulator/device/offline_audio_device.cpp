@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2020 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <common/log.hpp>
+
+#include "offline_audio_device.hpp"
+
+namespace nba {
+
+OfflineAudioDevice::~OfflineAudioDevice() {
+  CloseWAV();
+}
+
+bool OfflineAudioDevice::Open(void* userdata, Callback callback) {
+  callback_userdata = userdata;
+  this->callback = callback;
+  return true;
+}
+
+void OfflineAudioDevice::Close() {
+  callback = nullptr;
+}
+
+void OfflineAudioDevice::Synchronize(int samples_available) {
+  if (callback == nullptr || samples_available == 0) {
+    return;
+  }
+
+  auto samples = std::vector<std::int16_t>(samples_available * 2);
+
+  callback(callback_userdata, samples.data(), samples.size() * sizeof(std::int16_t));
+
+  if (output_buffer != nullptr) {
+    output_buffer->insert(output_buffer->end(), samples.begin(), samples.end());
+  }
+
+  if (writer.running) {
+    {
+      std::lock_guard<std::mutex> guard(writer.mutex);
+      writer.queue.push_back(std::move(samples));
+    }
+    writer.cv.notify_one();
+  }
+}
+
+bool OfflineAudioDevice::OpenWAV(std::string const& path) {
+  CloseWAV();
+
+  writer.file.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+  if (writer.file.fail()) {
+    LOG_ERROR("OfflineAudioDevice: unable to create file: {0}", path);
+    return false;
+  }
+
+  // The sizes in the header are updated once the file is closed.
+  writer.data_size = 0;
+  WriteHeader(0);
+
+  writer.quit = false;
+  writer.running = true;
+  writer.thread = std::thread{&OfflineAudioDevice::WriterThreadMain, this};
+  return true;
+}
+
+void OfflineAudioDevice::CloseWAV() {
+  if (!writer.running) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(writer.mutex);
+    writer.quit = true;
+  }
+  writer.cv.notify_one();
+  writer.thread.join();
+  writer.running = false;
+
+  writer.file.seekp(0);
+  WriteHeader(writer.data_size);
+  writer.file.close();
+}
+
+void OfflineAudioDevice::WriterThreadMain() {
+  std::unique_lock<std::mutex> lock(writer.mutex);
+
+  while (true) {
+    writer.cv.wait(lock, [this] {
+      return writer.quit || !writer.queue.empty();
+    });
+
+    if (writer.queue.empty()) {
+      return;
+    }
+
+    auto samples = std::move(writer.queue.front());
+    writer.queue.pop_front();
+
+    lock.unlock();
+    writer.file.write((char const*)samples.data(), samples.size() * sizeof(std::int16_t));
+    writer.data_size += samples.size() * sizeof(std::int16_t);
+    lock.lock();
+  }
+}
+
+void OfflineAudioDevice::WriteHeader(std::uint32_t data_size) {
+  auto write16 = [this](std::uint16_t value) {
+    writer.file.put(value & 0xFF);
+    writer.file.put(value >> 8);
+  };
+
+  auto write32 = [&](std::uint32_t value) {
+    write16(value & 0xFFFF);
+    write16(value >> 16);
+  };
+
+  writer.file.write("RIFF", 4);
+  write32(36 + data_size);
+  writer.file.write("WAVE", 4);
+
+  writer.file.write("fmt ", 4);
+  write32(16);
+  write16(1); // PCM
+  write16(2); // stereo
+  write32(samplerate);
+  write32(samplerate * 2 * sizeof(std::int16_t));
+  write16(2 * sizeof(std::int16_t));
+  write16(16);
+
+  writer.file.write("data", 4);
+  write32(data_size);
+}
+
+} // namespace nba
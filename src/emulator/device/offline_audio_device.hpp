@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2020 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio_device.hpp"
+
+namespace nba {
+
+/* Renders audio without real-time playback, e.g. to capture the audio of a game at maximum speed.
+ * The samples are pulled from the emulator as 16-bit stereo PCM, whenever it synchronizes the device.
+ * The samples are identical to those that would have been played back in real-time,
+ * as long as dynamic rate control is disabled.
+ */
+class OfflineAudioDevice : public AudioDevice {
+public:
+  OfflineAudioDevice(int samplerate = 48000) : samplerate(samplerate) {}
+ ~OfflineAudioDevice();
+
+  auto GetSampleRate() -> int final { return samplerate; }
+  auto GetBlockSize() -> int final { return 4096; }
+  bool Open(void* userdata, Callback callback) final;
+  void Close() final;
+  void Synchronize(int samples_available) final;
+
+  // Appends all subsequent samples to the given buffer (interleaved left and right samples).
+  void SetOutputBuffer(std::vector<std::int16_t>* buffer) { output_buffer = buffer; }
+
+  // The file is written on a separate thread, it is complete once CloseWAV() returns.
+  bool OpenWAV(std::string const& path);
+  void CloseWAV();
+
+private:
+  void WriterThreadMain();
+  void WriteHeader(std::uint32_t data_size);
+
+  int samplerate;
+  void* callback_userdata = nullptr;
+  Callback callback = nullptr;
+  std::vector<std::int16_t>* output_buffer = nullptr;
+
+  struct Writer {
+    bool running = false;
+    bool quit;
+    std::ofstream file;
+    std::uint32_t data_size;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<std::int16_t>> queue;
+  } writer;
+};
+
+} // namespace nba
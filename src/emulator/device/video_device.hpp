@@ -11,15 +11,41 @@
 
 namespace nba {
 
+enum class PixelFormat {
+  ARGB8888,
+  RGB565,
+  BGR555,
+  Indexed8
+};
+
+struct FrameBuffer {
+  PixelFormat format;
+  int width;
+  int height;
+  // Distance between two rows in bytes.
+  int stride;
+  void const* data;
+  // BGR555 colors for PixelFormat::Indexed8, otherwise unused.
+  std::uint16_t const* palette;
+  int palette_size;
+  // The image is identical to the one of the previous frame.
+  bool unchanged;
+
+  template<typename T>
+  auto Row(int y) const -> T const* {
+    return reinterpret_cast<T const*>(reinterpret_cast<std::uint8_t const*>(data) + y * stride);
+  }
+};
+
 class VideoDevice {
 public:
   virtual ~VideoDevice() {}
 
-  virtual void Draw(std::uint32_t* buffer) = 0;
+  virtual void Draw(FrameBuffer const& frame) = 0;
 };
 
 class NullVideoDevice : public VideoDevice {
-  void Draw(std::uint32_t* buffer) { }
+  void Draw(FrameBuffer const& frame) { }
 };
 
 } // namespace nba
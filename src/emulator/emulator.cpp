@@ -11,6 +11,7 @@
 
 #include <emulator/cartridge/header.hpp>
 #include <emulator/cartridge/game_db.hpp>
+#include <emulator/cartridge/rom_scan.hpp>
 #include <emulator/cartridge/backup/eeprom.hpp>
 #include <emulator/cartridge/backup/flash.hpp>
 #include <emulator/cartridge/backup/sram.hpp>
@@ -20,6 +21,7 @@
 #include <exception>
 #include <experimental/filesystem>
 #include <fstream>
+#include <random>
 #include <utility>
 #include <string_view>
 
@@ -44,42 +46,30 @@ Emulator::Emulator(std::shared_ptr<Config> config)
   Reset();
 }
 
-void Emulator::Reset() { cpu.Reset(); }
-
-auto Emulator::DetectBackupType(std::uint8_t* rom, size_t size) -> BackupType {
-  static constexpr std::pair<std::string_view, Config::BackupType> signatures[6] {
-    { "EEPROM_V",   BackupType::EEPROM_64 },
-    { "SRAM_V",     BackupType::SRAM      },
-    { "SRAM_F_V",   BackupType::SRAM      },
-    { "FLASH_V",    BackupType::FLASH_64  },
-    { "FLASH512_V", BackupType::FLASH_64  },
-    { "FLASH1M_V",  BackupType::FLASH_128 }
-  };
-
-  for (int i = 0; i < size; i += 4) {
-    for (auto const& [signature, type] : signatures) {
-      if ((i + signature.size()) <= size && std::memcmp(&rom[i], signature.data(), signature.size()) == 0) {
-        LOG_INFO("Found ROM string indicating {0} backup type.", std::to_string(type));
-        return type;
-      }
-    }
-  }
+void Emulator::Reset() {
+  common::logger::ScopedSink sink{config->log_sink};
+  cpu.Reset();
+  ApplyBootCache();
+}
 
-  return Config::BackupType::Detect;
+void Emulator::SoftReset() {
+  common::logger::ScopedSink sink{config->log_sink};
+  cpu.SoftReset();
+  ApplyBootCache();
 }
 
-auto Emulator::CreateBackupInstance(Config::BackupType backup_type, std::string save_path) -> Backup* {
+auto Emulator::CreateBackupInstance(Config::BackupType backup_type, std::string save_path, std::shared_ptr<Config> config) -> Backup* {
   switch (backup_type) {
     case BackupType::SRAM:
-      return new SRAM(save_path);
+      return new SRAM(save_path, config);
     case BackupType::FLASH_64:
-      return new FLASH(save_path, FLASH::SIZE_64K);
+      return new FLASH(save_path, FLASH::SIZE_64K, config);
     case BackupType::FLASH_128:
-      return new FLASH(save_path, FLASH::SIZE_128K);
+      return new FLASH(save_path, FLASH::SIZE_128K, config);
     case BackupType::EEPROM_4:
-      return new EEPROM(save_path, EEPROM::SIZE_4K);
+      return new EEPROM(save_path, EEPROM::SIZE_4K, config);
     case BackupType::EEPROM_64:
-      return new EEPROM(save_path, EEPROM::SIZE_64K);
+      return new EEPROM(save_path, EEPROM::SIZE_64K, config);
     default:
       throw std::logic_error("CreateBackupInstance: bad backup type 'Detect'.");
   }
@@ -122,10 +112,14 @@ auto Emulator::LoadBIOS() -> StatusCode {
   stream.read((char*)cpu.memory.bios, g_bios_size);
   stream.close();
 
+  bios_hash = HashROM(cpu.memory.bios, g_bios_size);
+
   return StatusCode::Ok;
 }
 
 auto Emulator::LoadGame(std::string const& path) -> StatusCode {
+  common::logger::ScopedSink sink{config->log_sink};
+
   size_t size;
   GameInfo game_info;
   std::string game_title;
@@ -175,6 +169,8 @@ auto Emulator::LoadGame(std::string const& path) -> StatusCode {
   game_code.assign(header->game.code, 4);
   game_maker.assign(header->game.maker, 2);
 
+  auto scan = ScanROM(rom.get(), size);
+
   /* If no save type was specified try to determine it from a list of
    * game override. Alternatively if that doesn't work, look for some
    * Nintendo SDK strings, that can reveal the save type.
@@ -192,10 +188,12 @@ auto Emulator::LoadGame(std::string const& path) -> StatusCode {
      */
     if (game_info.backup_type == Config::BackupType::Detect) {
       LOG_INFO("Unable to get backup type from game database.");
-      game_info.backup_type = DetectBackupType(rom.get(), size);
+      game_info.backup_type = scan->backup_type;
       if (game_info.backup_type == Config::BackupType::Detect) {
         game_info.backup_type = Config::BackupType::SRAM;
         LOG_WARN("Failed to determine backup type, fallback to SRAM.");
+      } else {
+        LOG_INFO("Found ROM string indicating {0} backup type.", std::to_string(game_info.backup_type));
       }
     }
   } else {
@@ -212,12 +210,15 @@ auto Emulator::LoadGame(std::string const& path) -> StatusCode {
   /* Mount cartridge into the cartridge slot. */
   cpu.memory.rom.data = std::move(rom);
   cpu.memory.rom.size = size;
+  cpu.memory.rom.scan = scan;
+  boot_snapshot.reset();
+  // The previous save must be flushed before its save file may be opened again.
+  cpu.memory.rom.backup_sram.reset();
+  cpu.memory.rom.backup_eeprom.reset();
   if (game_info.backup_type == Config::BackupType::EEPROM_4 || game_info.backup_type == Config::BackupType::EEPROM_64) {
-    cpu.memory.rom.backup_sram.reset();
-    cpu.memory.rom.backup_eeprom = std::unique_ptr<Backup>{ CreateBackupInstance(game_info.backup_type, save_path) };
+    cpu.memory.rom.backup_eeprom = std::unique_ptr<Backup>{ CreateBackupInstance(game_info.backup_type, save_path, config) };
   } else if (game_info.backup_type != Config::BackupType::None) {
-    cpu.memory.rom.backup_sram = std::unique_ptr<Backup>{ CreateBackupInstance(game_info.backup_type, save_path) };
-    cpu.memory.rom.backup_eeprom.reset();
+    cpu.memory.rom.backup_sram = std::unique_ptr<Backup>{ CreateBackupInstance(game_info.backup_type, save_path, config) };
   }
 
   /* Create and mount RTC if necessary. */
@@ -237,12 +238,130 @@ auto Emulator::LoadGame(std::string const& path) -> StatusCode {
   return StatusCode::Ok;
 }
 
+/* Boots the game from the snapshot of a previous boot, or takes a snapshot
+ * once the BIOS jumps to the game, so that the next boot can skip the BIOS intro.
+ */
+void Emulator::ApplyBootCache() {
+  if (config->skip_bios || config->boot_cache_path.empty() || !cpu.memory.rom.scan) {
+    return;
+  }
+
+  if (!boot_snapshot) {
+    boot_snapshot = ReadBootSnapshot();
+  }
+
+  if (boot_snapshot) {
+    cpu.LoadBootSnapshot(*boot_snapshot);
+    return;
+  }
+
+  cpu.RequestBootSnapshot([this](BootSnapshot const& snapshot) {
+    boot_snapshot = std::make_unique<BootSnapshot>(snapshot);
+    boot_snapshot->bios_hash = bios_hash;
+    boot_snapshot->rom_hash = cpu.memory.rom.scan->hash;
+    WriteBootSnapshot(*boot_snapshot);
+  });
+}
+
+auto Emulator::GetBootSnapshotPath() const -> std::string {
+  auto name = fmt::format("{0:016X}-{1:016X}.boot", bios_hash, cpu.memory.rom.scan->hash);
+
+  return (fs::path{config->boot_cache_path} / name).string();
+}
+
+auto Emulator::ReadBootSnapshot() const -> std::unique_ptr<BootSnapshot> {
+  auto path = GetBootSnapshotPath();
+
+  if (!fs::is_regular_file(path) || fs::file_size(path) != sizeof(BootSnapshot)) {
+    return {};
+  }
+
+  std::ifstream stream { path, std::ios::binary };
+  auto snapshot = std::make_unique<BootSnapshot>();
+
+  stream.read((char*)snapshot.get(), sizeof(BootSnapshot));
+
+  if (!stream.good() ||
+      snapshot->magic != BootSnapshot::kMagic ||
+      snapshot->version != BootSnapshot::kVersion ||
+      snapshot->size != sizeof(BootSnapshot) ||
+      snapshot->bios_hash != bios_hash ||
+      snapshot->rom_hash != cpu.memory.rom.scan->hash) {
+    LOG_WARN("Ignoring invalid boot snapshot: {0}", path);
+    return {};
+  }
+
+  LOG_INFO("Skipping the BIOS intro with boot snapshot: {0}", path);
+  return snapshot;
+}
+
+void Emulator::WriteBootSnapshot(BootSnapshot const& snapshot) const {
+  auto path = GetBootSnapshotPath();
+
+  /* Multiple instances may share the cache, so the snapshot is written to a temporary file first.
+   * Renaming it is atomic, other instances either see the whole snapshot or none at all.
+   */
+  auto path_tmp = fmt::format("{0}.{1:08X}.tmp", path, std::random_device{}());
+  std::error_code error;
+
+  fs::create_directories(config->boot_cache_path, error);
+
+  std::ofstream stream { path_tmp, std::ios::binary };
+  stream.write((char const*)&snapshot, sizeof(BootSnapshot));
+  stream.close();
+
+  if (stream.fail()) {
+    LOG_ERROR("Failed to write boot snapshot: {0}", path_tmp);
+    fs::remove(path_tmp, error);
+    return;
+  }
+
+  fs::rename(path_tmp, path, error);
+
+  if (error) {
+    LOG_ERROR("Failed to write boot snapshot: {0}", path);
+    fs::remove(path_tmp, error);
+    return;
+  }
+
+  LOG_INFO("Wrote boot snapshot: {0}", path);
+}
+
 void Emulator::Run(int cycles) {
+  common::logger::ScopedSink sink{config->log_sink};
   cpu.RunFor(cycles);
+  config->audio_dev->Synchronize(GetAudioBufferLevel());
 }
 
 void Emulator::Frame() {
+  common::logger::ScopedSink sink{config->log_sink};
+  ResetStats();
   cpu.RunFor(g_cycles_per_frame);
+  config->audio_dev->Synchronize(GetAudioBufferLevel());
+}
+
+void Emulator::SetKeys(std::uint16_t mask, int cycle) {
+  cpu.SetKeys(mask, cycle);
+}
+
+void Emulator::QueueKeys(std::uint16_t mask, std::uint64_t timestamp) {
+  cpu.QueueKeys(mask, timestamp);
+}
+
+auto Emulator::GetStats() const -> core::Stats const& {
+  return cpu.stats;
+}
+
+void Emulator::ResetStats() {
+  cpu.stats = {};
+}
+
+auto Emulator::GetAudioBufferLevel() -> int {
+  return cpu.apu.buffer->Available();
+}
+
+auto Emulator::GetAudioUnderruns() -> int {
+  return cpu.apu.underruns.load(std::memory_order_relaxed);
 }
 
 } // namespace nba
@@ -26,20 +26,47 @@ public:
   Emulator(std::shared_ptr<Config> config);
 
   void Reset();
+  void SoftReset();
   virtual auto LoadGame(std::string const& path) -> StatusCode;
   virtual void Run(int cycles);
   virtual void Frame();
 
+  // Sets the state of all keys at once, optionally at the given cycle of the next Run() or Frame(). See CPU::SetKeys().
+  void SetKeys(std::uint16_t mask, int cycle = 0);
+
+  /* Queues a key mask for the given cycle since the reset (a frame is 280896 cycles), see CPU::QueueKeys().
+   * Unlike the other methods this may be called from a thread other than the one that runs the emulator.
+   */
+  void QueueKeys(std::uint16_t mask, std::uint64_t timestamp = 0);
+
+  // Number of samples that are queued for the audio device.
+  auto GetAudioBufferLevel() -> int;
+  auto GetAudioUnderruns() -> int;
+
+  /* Profiling counters since the start of the last Frame() or the last call to ResetStats().
+   * The counters are only collected in builds with the NBA_STATS option.
+   */
+  auto GetStats() const -> core::Stats const&;
+  void ResetStats();
+
 private:
-  static auto DetectBackupType(std::uint8_t* rom, size_t size) -> Config::BackupType;
-  static auto CreateBackupInstance(Config::BackupType backup_type, std::string save_path) -> Backup*;
+  static auto CreateBackupInstance(Config::BackupType backup_type, std::string save_path, std::shared_ptr<Config> config) -> Backup*;
   static auto CalculateMirrorMask(size_t size) -> std::uint32_t;
 
   auto virtual LoadBIOS() -> StatusCode;
 
+  void ApplyBootCache();
+  auto GetBootSnapshotPath() const -> std::string;
+  auto ReadBootSnapshot() const -> std::unique_ptr<core::BootSnapshot>;
+  void WriteBootSnapshot(core::BootSnapshot const& snapshot) const;
+
   core::CPU cpu;
   bool bios_loaded = false;
+  std::uint64_t bios_hash = 0;
   std::shared_ptr<Config> config;
+
+  // Snapshot of the current game after the BIOS intro, if the boot cache is enabled.
+  std::unique_ptr<core::BootSnapshot> boot_snapshot;
 };
 
 } // namespace nba
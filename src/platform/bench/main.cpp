@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2020 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <chrono>
+#include <common/log.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <emulator/emulator.hpp>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Runs each ROM headless for a fixed number of frames and reports the speed as JSON.
+ * The video and audio output is discarded, input can be replayed from a movie file.
+ */
+
+// Must match g_cycles_per_frame in emulator.cpp
+static constexpr int kCyclesPerFrame = 280896;
+
+static auto g_config = std::make_shared<nba::Config>();
+static int g_frames = 600;
+static int g_warmup = 60;
+static std::string g_movie_path;
+static std::string g_output_path;
+static std::vector<std::string> g_rom_paths;
+
+// Key masks (as for Emulator::SetKeys()) by the frame from which they apply.
+static std::map<int, std::uint16_t> g_movie;
+
+struct Result {
+  std::string rom_path;
+  double seconds;
+  nba::core::Stats stats;
+};
+
+void usage(char* app_name) {
+  fmt::print("Usage: {0} [--bios bios_path] [--skip-bios yes/no] [--boot-cache path] [--frames count] [--warmup count] "
+             "[--movie path] [--render-mode inline/threaded/stripes] [--output path] rom_path...\n", app_name);
+  std::exit(-1);
+}
+
+void parse_arguments(int argc, char** argv) {
+  auto i = 1;
+  while (i < argc) {
+    auto key = std::string{argv[i++]};
+    if (key.rfind("--", 0) != 0) {
+      g_rom_paths.push_back(key);
+      continue;
+    }
+    if (i == argc) {
+      usage(argv[0]);
+    }
+    auto value = std::string{argv[i++]};
+    if (key == "--bios") {
+      g_config->bios_path = value;
+    } else if (key == "--skip-bios") {
+      if (value == "yes") {
+        g_config->skip_bios = true;
+      } else if (value == "no") {
+        g_config->skip_bios = false;
+      } else {
+        usage(argv[0]);
+      }
+    } else if (key == "--boot-cache") {
+      g_config->boot_cache_path = value;
+    } else if (key == "--frames") {
+      g_frames = std::atoi(value.c_str());
+      if (g_frames <= 0) {
+        usage(argv[0]);
+      }
+    } else if (key == "--warmup") {
+      g_warmup = std::atoi(value.c_str());
+    } else if (key == "--movie") {
+      g_movie_path = value;
+    } else if (key == "--render-mode") {
+      using RenderMode = nba::Config::Video::RenderMode;
+      if (value == "inline") {
+        g_config->video.render_mode = RenderMode::Inline;
+      } else if (value == "threaded") {
+        g_config->video.render_mode = RenderMode::Threaded;
+      } else if (value == "stripes") {
+        g_config->video.render_mode = RenderMode::Stripes;
+      } else {
+        usage(argv[0]);
+      }
+    } else if (key == "--output") {
+      g_output_path = value;
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (g_rom_paths.empty()) {
+    usage(argv[0]);
+  }
+}
+
+/* A movie is a text file with one "<frame> <keys>" pair per line,
+ * where keys is a hexadecimal mask in KEYINPUT order (set bits are pressed keys).
+ * The keys stay pressed until a later line changes them. Lines starting with '#' are ignored.
+ */
+void load_movie(std::string const& path) {
+  std::ifstream file{path};
+  std::string line;
+
+  if (!file.good()) {
+    fmt::print(stderr, "Cannot open movie: {0}\n", path);
+    std::exit(-2);
+  }
+
+  while (std::getline(file, line)) {
+    int frame;
+    unsigned int keys;
+
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    if (std::sscanf(line.c_str(), "%d %x", &frame, &keys) != 2) {
+      fmt::print(stderr, "Bad line in movie: {0}\n", line);
+      std::exit(-2);
+    }
+    g_movie[frame] = std::uint16_t(keys & 0x3FF);
+  }
+}
+
+void accumulate(nba::core::Stats& total, nba::core::Stats const& frame) {
+  auto add = [](auto& dst, auto const& src) {
+    for (size_t i = 0; i < std::size(dst); i++) {
+      dst[i] += src[i];
+    }
+  };
+
+  add(total.instructions, frame.instructions);
+  total.cycles_halted += frame.cycles_halted;
+  add(total.dma_cycles, frame.dma_cycles);
+  add(total.events, frame.events);
+  total.scanlines_rendered += frame.scanlines_rendered;
+  total.scanlines_skipped += frame.scanlines_skipped;
+  add(total.mmio_reads, frame.mmio_reads);
+  add(total.mmio_writes, frame.mmio_writes);
+  total.prefetch_hits += frame.prefetch_hits;
+  total.prefetch_misses += frame.prefetch_misses;
+}
+
+auto run(std::string const& rom_path) -> Result {
+  using StatusCode = nba::Emulator::StatusCode;
+
+  auto emulator = std::make_unique<nba::Emulator>(g_config);
+  auto result = Result{rom_path, 0, {}};
+
+  switch (emulator->LoadGame(rom_path)) {
+  case StatusCode::GameNotFound:
+    fmt::print(stderr, "Cannot open ROM: {0}\n", rom_path);
+    std::exit(-2);
+  case StatusCode::BiosNotFound:
+    fmt::print(stderr, "Cannot open BIOS: {0}\n", g_config->bios_path);
+    std::exit(-3);
+  case StatusCode::GameWrongSize:
+    fmt::print(stderr, "The provided ROM file is larger than the maximum 32 MiB.\n");
+    std::exit(-4);
+  case StatusCode::BiosWrongSize:
+    fmt::print(stderr, "The provided BIOS file does not match the expected size of 16 KiB.\n");
+    std::exit(-5);
+  default:
+    break;
+  }
+
+  emulator->Reset();
+
+  auto movie = g_movie.begin();
+
+  for (int frame = 0; frame < g_warmup + g_frames; frame++) {
+    if (frame == g_warmup) {
+      result.seconds = 0;
+      result.stats = {};
+    }
+
+    while (movie != g_movie.end() && movie->first <= frame) {
+      emulator->SetKeys(movie->second);
+      movie++;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    emulator->Frame();
+    auto t1 = std::chrono::steady_clock::now();
+
+    result.seconds += std::chrono::duration<double>(t1 - t0).count();
+    accumulate(result.stats, emulator->GetStats());
+  }
+
+  return result;
+}
+
+auto escape(std::string const& string) -> std::string {
+  std::string result;
+
+  for (char c : string) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+    }
+    result += c;
+  }
+  return result;
+}
+
+auto to_json(Result const& result) -> std::string {
+  static const char* event_names[] { "cpu", "ppu", "apu", "irq", "dma", "timer", "input" };
+
+  static_assert(std::size(event_names) == int(nba::core::EventClass::Count), "to_json: event names are out of date.");
+
+  auto const& stats = result.stats;
+  auto cycles = double(g_frames) * kCyclesPerFrame;
+  auto json = fmt::format(
+    "    {{\n"
+    "      \"rom\": \"{0}\",\n"
+    "      \"frames\": {1},\n"
+    "      \"seconds\": {2:.6f},\n"
+    "      \"fps\": {3:.2f},\n"
+    "      \"ns_per_cycle\": {4:.4f}",
+    escape(result.rom_path), g_frames, result.seconds, g_frames / result.seconds, result.seconds * 1e9 / cycles);
+
+#ifdef NBA_STATS
+  std::string events;
+  std::string mmio;
+
+  for (int i = 0; i < int(std::size(event_names)); i++) {
+    events += fmt::format("{0}\"{1}\": {2}", i == 0 ? "" : ", ", event_names[i], stats.events[i]);
+  }
+
+  for (int i = 0; i < int(std::size(stats.mmio_reads)); i++) {
+    if (stats.mmio_reads[i] != 0 || stats.mmio_writes[i] != 0) {
+      mmio += fmt::format("{0}\"0x{1:08X}\": [{2}, {3}]", mmio.empty() ? "" : ", ",
+                          0x04000000 + i * 2, stats.mmio_reads[i], stats.mmio_writes[i]);
+    }
+  }
+
+  json += fmt::format(
+    ",\n"
+    "      \"stats\": {{\n"
+    "        \"instructions\": {{\"arm\": {0}, \"thumb\": {1}}},\n"
+    "        \"cycles_halted\": {2},\n"
+    "        \"dma_cycles\": [{3}, {4}, {5}, {6}],\n"
+    "        \"events\": {{{7}}},\n"
+    "        \"scanlines\": {{\"rendered\": {8}, \"skipped\": {9}}},\n"
+    "        \"prefetch\": {{\"hits\": {10}, \"misses\": {11}}},\n"
+    "        \"mmio\": {{{12}}}\n"
+    "      }}",
+    stats.instructions[0], stats.instructions[1], stats.cycles_halted,
+    stats.dma_cycles[0], stats.dma_cycles[1], stats.dma_cycles[2], stats.dma_cycles[3],
+    events, stats.scanlines_rendered, stats.scanlines_skipped,
+    stats.prefetch_hits, stats.prefetch_misses, mmio);
+#else
+  (void)stats;
+#endif
+
+  return json + "\n    }";
+}
+
+int main(int argc, char** argv) {
+  std::vector<Result> results;
+
+  // Keep the log away from the JSON output.
+  common::logger::set_default_sink(std::make_shared<common::logger::ConsoleSink>(stderr));
+
+  // Measure the game rather than the BIOS intro, unless asked otherwise.
+  g_config->skip_bios = true;
+  g_config->save_mode = nba::Config::SaveMode::Ephemeral;
+
+  parse_arguments(argc, argv);
+
+  if (!g_movie_path.empty()) {
+    load_movie(g_movie_path);
+  }
+
+  for (auto const& rom_path : g_rom_paths) {
+    results.push_back(run(rom_path));
+  }
+
+  auto json = std::string{"{\n  \"results\": [\n"};
+
+  for (size_t i = 0; i < results.size(); i++) {
+    json += to_json(results[i]);
+    json += i + 1 == results.size() ? "\n" : ",\n";
+  }
+  json += "  ]\n}\n";
+
+  if (g_output_path.empty()) {
+    fmt::print("{0}", json);
+  } else {
+    std::ofstream file{g_output_path};
+    file << json;
+    if (!file.good()) {
+      fmt::print(stderr, "Cannot write output: {0}\n", g_output_path);
+      return -6;
+    }
+  }
+
+  return 0;
+}
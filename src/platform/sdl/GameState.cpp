@@ -325,8 +325,10 @@ void CombinedInputDevice::SetOnChangeCallback(std::function<void()> callback) {
     this->gs->g_controller_input_device.SetOnChangeCallback(callback);
 }
 
-void SDL2_VideoDevice::Draw(std::uint32_t *buffer) {
-    std::memcpy(this->gs.g_framebuffer, buffer,
-                sizeof(std::uint32_t) * this->gs.kNativeWidth * this->gs.kNativeHeight);
+void SDL2_VideoDevice::Draw(nba::FrameBuffer const& frame) {
+    for (int y = 0; y < this->gs->kNativeHeight; y++) {
+        std::memcpy(&this->gs->g_framebuffer[y * this->gs->kNativeWidth], frame.Row<std::uint32_t>(y),
+                    sizeof(std::uint32_t) * this->gs->kNativeWidth);
+    }
     this->gs->g_frame_counter++;
 }
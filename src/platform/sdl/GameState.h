@@ -83,7 +83,7 @@ struct SDL2_VideoDevice : public nba::VideoDevice {
 public:
     GameState* gs;
     SDL2_VideoDevice(GameState* gs);
-    void Draw(std::uint32_t* buffer) final;
+    void Draw(nba::FrameBuffer const& frame) final;
 };
 
 #endif //NANOBOYADVANCE_GAMESTATE_H
@@ -10,6 +10,7 @@
 #endif
 
 #include <atomic>
+#include <chrono>
 #include <common/log.hpp>
 #include <cstdlib>
 #include <cstring>
@@ -22,6 +23,7 @@
 #include <iterator>
 #include <optional>
 #include <string>
+#include <thread>
 #include <toml.hpp>
 #include <unordered_map>
 
@@ -38,21 +40,25 @@ static SDL_Window* g_window;
 static SDL_GLContext g_gl_context;
 static GLuint g_gl_texture;
 static std::uint32_t g_framebuffer[kNativeWidth * kNativeHeight];
-static auto g_frame_counter = 0;
+static std::atomic_int g_frame_counter = 0;
 static auto g_swap_interval = 1;
 
 static std::atomic_bool g_sync_to_audio = true;
-static int g_cycles_per_audio_frame = 0;
+static int g_cycles_per_audio_slice = 0;
+static int g_audio_buffer_target = 0;
 
 static auto g_keyboard_input_device = nba::BasicInputDevice{};
 static auto g_controller_input_device = nba::BasicInputDevice{};
 static SDL_GameController* g_game_controller = nullptr;
 static auto g_game_controller_button_x_old = false;
 static auto g_fastforward = false;
+static std::uint16_t g_keys = 0;
 
 static auto g_config = std::make_shared<nba::Config>();
 static auto g_emulator = std::make_unique<nba::Emulator>(g_config);
 static auto g_emulator_lock = std::mutex{};
+static auto g_emulator_thread = std::thread{};
+static std::atomic_bool g_emulator_quit = false;
 
 struct KeyMap {
   SDL_Keycode fastforward = SDLK_SPACE;
@@ -61,20 +67,29 @@ struct KeyMap {
   std::unordered_map<SDL_Keycode, nba::InputDevice::Key> gba;
 } keymap;
 
+void queue_keys();
+
 struct CombinedInputDevice : public nba::InputDevice {
   auto Poll(Key key) -> bool final {
     return g_keyboard_input_device.Poll(key) || g_controller_input_device.Poll(key);
   }
 
+  /* Key changes happen on the event thread, so instead of calling back into the emulator
+   * they are passed to the emulator thread through the emulator's input queue.
+   */
   void SetOnChangeCallback(std::function<void(void)> callback) {
-    g_keyboard_input_device.SetOnChangeCallback(callback);
-    g_controller_input_device.SetOnChangeCallback(callback);
+    g_keyboard_input_device.SetOnChangeCallback(queue_keys);
+    g_controller_input_device.SetOnChangeCallback(queue_keys);
   }
 };
 
 struct SDL2_VideoDevice : public nba::VideoDevice {
-  void Draw(std::uint32_t* buffer) final {
-    std::memcpy(g_framebuffer, buffer, sizeof(std::uint32_t) * kNativeWidth * kNativeHeight);
+  void Draw(nba::FrameBuffer const& frame) final {
+    if (!frame.unchanged) {
+      for (int y = 0; y < kNativeHeight; y++) {
+        std::memcpy(&g_framebuffer[y * kNativeWidth], frame.Row<std::uint32_t>(y), sizeof(std::uint32_t) * kNativeWidth);
+      }
+    }
     g_frame_counter++;
   }
 };
@@ -84,7 +99,7 @@ void update_fullscreen();
 void update_viewport();
 void update_key(SDL_KeyboardEvent* event);
 void update_controller();
-void audio_passthrough(SDL2_AudioDevice* audio_device, std::int16_t* stream, int byte_len);
+void emulate();
 
 void usage(char* app_name) {
   fmt::print("Usage: {0} [--bios bios_path] [--force-rtc] [--save-type type] [--fullscreen] [--scale factor] [--resampler type] [--sync-to-audio yes/no] rom_path\n", app_name);
@@ -336,12 +351,28 @@ void init(int argc, char** argv) {
     }
   }
   auto audio_device = std::make_shared<SDL2_AudioDevice>();
-  audio_device->SetPassthrough((SDL_AudioCallback)audio_passthrough);
   g_config->audio_dev = audio_device;
   g_config->input_dev = std::make_shared<CombinedInputDevice>();
   g_config->video_dev = std::make_shared<SDL2_VideoDevice>();
+  g_config->video.pixel_format = nba::PixelFormat::ARGB8888;
   g_emulator->Reset();
-  g_cycles_per_audio_frame = 16777216ULL * audio_device->GetBlockSize() / audio_device->GetSampleRate();
+  // Emulate in slices of a quarter audio block, until two blocks of audio are queued.
+  g_cycles_per_audio_slice = 16777216ULL * audio_device->GetBlockSize() / audio_device->GetSampleRate() / 4;
+  g_audio_buffer_target = audio_device->GetBlockSize() * 2;
+  g_emulator_thread = std::thread{emulate};
+}
+
+void emulate() {
+  while (!g_emulator_quit) {
+    if (g_sync_to_audio) {
+      std::unique_lock<std::mutex> lock{g_emulator_lock};
+      if (g_emulator->GetAudioBufferLevel() < g_audio_buffer_target) {
+        g_emulator->Run(g_cycles_per_audio_slice);
+        continue;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
 }
 
 void loop() {
@@ -383,9 +414,9 @@ void loop() {
     SDL_GL_SwapWindow(g_window);
     auto ticks_end = SDL_GetTicks();
     if ((ticks_end - ticks_start) >= 1000) {
-      auto title = fmt::format("NanoBoyAdvance [{0} fps | {1}%]", g_frame_counter, int(g_frame_counter / 60.0 * 100.0));
+      auto frames = g_frame_counter.exchange(0);
+      auto title = fmt::format("NanoBoyAdvance [{0} fps | {1}% | {2} underruns]", frames, int(frames / 60.0 * 100.0), g_emulator->GetAudioUnderruns());
       SDL_SetWindowTitle(g_window, title.c_str());
-      g_frame_counter = 0;
       ticks_start = ticks_end;
     }
     while (SDL_PollEvent(&event)) {
@@ -398,8 +429,8 @@ void loop() {
 }
 
 void destroy() {
-  // Make sure that the audio thread no longer accesses the emulator.
-  g_emulator_lock.lock();
+  g_emulator_quit = true;
+  g_emulator_thread.join();
   if (g_game_controller != nullptr) {
     SDL_GameControllerClose(g_game_controller);
   }
@@ -408,15 +439,6 @@ void destroy() {
   SDL_QuitSubSystem(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_GAMECONTROLLER);
 }
 
-void audio_passthrough(SDL2_AudioDevice* audio_device, std::int16_t* stream, int byte_len) {
-  if (g_sync_to_audio) {
-    g_emulator_lock.lock();
-    g_emulator->Run(g_cycles_per_audio_frame);
-    g_emulator_lock.unlock();
-  }
-  audio_device->InvokeCallback(stream, byte_len);
-}
-
 void update_fullscreen() {
   SDL_SetWindowFullscreen(g_window, g_config->video.fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
 }
@@ -452,6 +474,9 @@ void update_key(SDL_KeyboardEvent* event) {
     g_emulator_lock.lock();
     g_emulator->Reset();
     g_emulator_lock.unlock();
+    // Queued input is discarded on reset, keys that are still held must be queued again.
+    g_keys = 0;
+    queue_keys();
   }
 
   if (key == keymap.fullscreen && !pressed) {
@@ -465,6 +490,28 @@ void update_key(SDL_KeyboardEvent* event) {
   }
 }
 
+void queue_keys() {
+  using Key = nba::InputDevice::Key;
+
+  // Same order as the bits of KEYINPUT.
+  static constexpr Key keys[] {
+    Key::A, Key::B, Key::Select, Key::Start, Key::Right, Key::Left, Key::Up, Key::Down, Key::R, Key::L
+  };
+
+  std::uint16_t mask = 0;
+
+  for (int i = 0; i < nba::InputDevice::kKeyCount; i++) {
+    if (g_keyboard_input_device.Poll(keys[i]) || g_controller_input_device.Poll(keys[i])) {
+      mask |= 1 << i;
+    }
+  }
+
+  if (mask != g_keys) {
+    g_emulator->QueueKeys(mask);
+    g_keys = mask;
+  }
+}
+
 void update_controller() {
   if (g_game_controller == nullptr)
     return;